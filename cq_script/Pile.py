@@ -7,7 +7,13 @@ layout = globals().get('layout', "2x3")
 hSpacing = globals().get('hSpacing', 2500.0)
 vSpacing = globals().get('vSpacing', 3000.0)
 
-pile = cq.Workplane('XY').circle(diameter / 2.0).extrude(length)
+# 工作进程提供的几何缓存（单独运行脚本时不存在）
+cache = globals().get('cache')
+
+def build_pile():
+    return cq.Workplane('XY').circle(diameter / 2.0).extrude(length)
+
+pile = cache.get_or_build(('Pile.pile', diameter, length), build_pile) if cache else build_pile()
 assy = cq.Assembly()
 
 if layout == "2x3":
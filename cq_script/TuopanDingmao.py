@@ -19,6 +19,11 @@ height = 2750.0
 length = 3900.0
 width = 2400.0
 concreteGrade = "C50"
+capThickness = 250.0
+
+# 输出参数：供拼装时安放垫石与支座
+top = height + capThickness  # 顶帽顶面标高
+seatX = 1650.0               # 支承垫石中心距墩中心线的横向距离
 
 w = cq.Workplane('XY')
 w = draw(w, 1600, 1400, 3000, 1374, 1300, 1200)
@@ -28,7 +33,7 @@ tuopan = w.loft()
 
 w = cq.Workplane('XY').workplane(offset=height)
 w = draw(w, 2400, 1500, 3900, 1471, 1400, 1300)
-w = draw(w.workplane(offset=250), 2400, 1500, 3900, 1471, 1400, 1300)
+w = draw(w.workplane(offset=capThickness), 2400, 1500, 3900, 1471, 1400, 1300)
 dingmao = w.loft()
 
 cutter = (cq.Workplane('XZ').moveTo(-750, 3000).lineTo(-750, 2700)
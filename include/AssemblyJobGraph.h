@@ -0,0 +1,61 @@
+#ifndef ASSEMBLYJOBGRAPH_H
+#define ASSEMBLYJOBGRAPH_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QVariantMap>
+
+// 多构件拼装的任务图
+// 构件可声明输入参数依赖其他构件的 out 参数（如桩基取墩身的实际高度）。
+// 无依赖的构件立即发出，有依赖的构件在输入全部就绪后发出，
+// 总耗时取决于关键路径而非构件数量。
+// 上游 out 参数随响应头部到达即可解析，不必等待其 B-rep 正文。
+class AssemblyJobGraph {
+public:
+  void clear();
+
+  // 添加构件任务，返回任务编号（按添加顺序从 0 开始）
+  int addJob(const QString &modelType, const QJsonObject &args);
+  // 将 job 的输入参数 arg 绑定到 source 的 out 参数 sourceArg。
+  // 依赖关系须无环；上游失败或未输出该参数时沿用 addJob 给定的值
+  void bind(int job, const QString &arg, int source, const QString &sourceArg);
+
+  // 取出输入已全部就绪、尚未发出的任务，并标记为已发出
+  QList<int> takeReady();
+  // 上游 out 参数到达（重复调用忽略）
+  void resolveOutputs(int job, const QVariantMap &outputs);
+  // 任务结束；失败且尚未解析 out 参数时按空参数解析，下游沿用默认值
+  void complete(int job, bool succeeded);
+
+  int size() const { return m_jobs.size(); }
+  bool isFinished() const;
+  int failedCount() const;
+  QString modelType(int job) const { return m_jobs[job].modelType; }
+  QJsonObject inputArgs(int job) const; // 固定参数叠加已解析的绑定值
+  double output(int job, const QString &arg, double fallback) const;
+
+private:
+  struct Binding {
+    QString arg;
+    int source;
+    QString sourceArg;
+  };
+
+  struct Job {
+    QString modelType;
+    QJsonObject args;
+    QList<Binding> bindings;
+    QVariantMap outputs;
+    bool dispatched = false;
+    bool resolved = false; // out 参数已到达
+    bool completed = false;
+    bool failed = false;
+  };
+
+  bool inputsResolved(const Job &job) const;
+
+  QList<Job> m_jobs;
+};
+
+#endif // ASSEMBLYJOBGRAPH_H
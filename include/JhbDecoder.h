@@ -0,0 +1,92 @@
+#ifndef JHBDECODER_H
+#define JHBDECODER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <TopoDS_Shape.hxx>
+
+#include <memory>
+#include <thread>
+
+class JhbBodyStream;
+class QFile;
+class JhbInflater;
+
+// JHB (JSON-Header + Binary-Body) 增量解码器
+// 格式: [4字节小端长度 L][L字节 JSON 或 CBOR 头部][B-rep 正文]
+// 在 QNetworkReply::readyRead 中持续 feed()：头部一到达即发出 headerReady，
+// B-rep 正文按块交给后台线程中的 BRepTools::Read，与网络传输并行解析。
+// 头部带 bodyEncoding 时正文为压缩流，按块解压后再进入上述流程；
+// 头部带 localBody 时正文位于本机交付文件中，映射后直接在映射区解析；
+// 只接受交付目录内、文件名为 <uuid>.<ext> 的文件，映射成功后才删除。
+class JhbDecoder : public QObject {
+  Q_OBJECT
+
+public:
+  explicit JhbDecoder(QObject *parent = nullptr);
+  ~JhbDecoder() override;
+
+  void feed(const QByteArray &chunk);
+  void finish(); // 数据已全部到达
+  void abort();  // 放弃解析（网络错误等）
+
+  // 本构建可解压的正文编码（按偏好排序），作为请求的 accept_encoding
+  static QStringList supportedEncodings();
+
+  // 服务端的同机交付目录；未设置时拒绝所有 localBody
+  void setHandoffDirectory(const QString &directory) {
+    m_handoffDir = directory;
+  }
+
+  bool hasHeader() const { return m_state > State::Header; }
+  // 已发出 decoded 或 failed（之后的 feed/finish 不再有效果）
+  bool isDone() const { return m_state == State::Done; }
+  const QVariantMap &metadata() const { return m_metadata; }
+
+signals:
+  void headerReady(const QVariantMap &metadata);
+  // 正文为 B-rep 时 shape 为流式解析结果、body 为空；
+  // 其他格式 (如 STEP) 无法流式解析，shape 为空、body 为完整正文
+  void decoded(const TopoDS_Shape &shape, const QByteArray &body);
+  void failed(const QString &error);
+
+private:
+  enum class State { Length, Header, Body, Done };
+  enum class BodyMode { Unknown, Stream, Buffer, Local };
+
+  static QVariantMap parseHeader(const QByteArray &data);
+  void consumeBody(const QByteArray &chunk);
+  void consumePlainBody(const QByteArray &chunk);
+  void fail(const QString &error);
+  void selectBodyMode();
+  void startStreaming();
+  void startLocalParse();
+  QString handoffFilePath(const QString &path) const;
+  void releaseLocalBody();
+  void onParserFinished(const TopoDS_Shape &shape);
+  void emitDecoded();
+
+  State m_state = State::Length;
+  QByteArray m_pending; // 尚未凑满的长度/头部/正文前缀字节
+  quint32 m_headerLength = 0;
+  QVariantMap m_metadata;
+  std::unique_ptr<JhbInflater> m_inflater; // 正文未压缩时为空
+
+  bool m_finished = false;
+  BodyMode m_bodyMode = BodyMode::Unknown; // Stream: 正文交由后台线程解析
+  bool m_parserDone = false;
+  QByteArray m_body; // 非 B-rep 正文的缓冲
+  TopoDS_Shape m_shape;
+
+  std::shared_ptr<JhbBodyStream> m_stream;
+  QString m_handoffDir;
+  std::unique_ptr<QFile> m_localFile; // 交付文件
+  bool m_localMapped = false;         // 映射成功，解析结束后删除
+  std::thread m_parser;
+};
+
+#endif // JHBDECODER_H
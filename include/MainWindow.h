@@ -1,11 +1,13 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "AssemblyJobGraph.h"
 #include "SARibbonMainWindow.h"
 #include <QCheckBox>
 #include <QDockWidget>
 #include <QDoubleSpinBox>
 #include <QElapsedTimer>
+#include <QHash>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QList>
@@ -15,7 +17,9 @@
 #include <QPushButton>
 #include <QQueue>
 #include <QScrollArea>
+#include <QSet>
 #include <QTextEdit>
+#include <QUrl>
 #include <QVBoxLayout>
 
 #include <TopoDS_Shape.hxx>
@@ -25,7 +29,9 @@
 #include "OCCTWidget.h"
 
 class ShxTextGenerator;
+class JhbDecoder;
 class QLabel;
+class QTimer;
 class QTextEdit;
 class PythonSyntaxHighlighter;
 #include <Graphic3d_NameOfMaterial.hxx>
@@ -55,7 +61,10 @@ private slots:
   void onObjectSelected(const QVariantMap &metadata);
 
   // Microservice Connection
-  void onCqNetworkReply(QNetworkReply *reply, int assemblyIndex);
+  void onCqNetworkReply(QNetworkReply *reply, int assemblyIndex,
+                        JhbDecoder *decoder);
+  void onCqPartDecoded(int assemblyIndex, const TopoDS_Shape &shape,
+                       const QVariantMap &metadata);
 
 private:
   void createRibbon();
@@ -63,8 +72,21 @@ private:
   void initializeCqNetwork();
   void sendScriptToMicroservice(const QString &code, const QJsonObject &args,
                                 int assemblyIndex,
-                                const QString &modelType = QString());
+                                const QString &modelType = QString(),
+                                int attempts = 0);
   void dispatchTask(int dummy = 0);
+  void startPierAssembly();
+  void dispatchReadyJobs();
+  void finishPierAssembly();
+  void regenerateSelection(const QString &modelType, const QJsonObject &edits);
+  void fetchSchemas();
+  void pollServiceReady(int endpoint);
+  void updateServiceLabel();
+  int pickEndpoint() const;
+  QUrl serviceUrl(int endpoint, const QString &path) const;
+  void startMetricsPolling();
+  void pollMetrics();
+  void resolveSchema(QVariantMap &metadata);
   QString readScript(const QString &modelName);
 
   OCCTWidget *m_occtWidget;
@@ -77,7 +99,36 @@ private:
   QCheckBox *m_solidTextCheckbox;
   std::unique_ptr<ShxTextGenerator> m_shxGenerator;
   QLabel *m_coordLabel;
+  QLabel *m_serviceLabel = nullptr; // 服务连接/预热状态
+  // 批量生成期间轮询服务端 /api/v1/metrics，在状态栏显示各阶段平均耗时
+  QLabel *m_metricsLabel = nullptr;
+  QTimer *m_metricsTimer = nullptr;
+  QJsonObject m_metricsBaseline; // 批量开始时的指标快照，显示值为此后的区间平均
+  bool m_metricsPollPending = false;
   QSharedPointer<QNetworkAccessManager> m_networkManager;
+  // 建模服务实例 (QTOCCT_SERVICE_ENDPOINTS 逗号分隔，如同机多个端口)，
+  // 任务分配给未完成请求最少的实例，实例出错时转发到其他实例
+  struct ServiceEndpoint {
+    QUrl base;
+    int outstanding = 0;   // 已发出、尚未完成的请求数
+    qint64 downUntil = 0;  // 出错后暂停分配的截止时间 (ms since epoch)
+    bool reachable = false;
+    bool ready = false;
+    int workers = 0;
+    int minWorkers = 0;
+    // 该实例已缓存的脚本哈希（各实例的脚本缓存相互独立），之后只发送哈希
+    QSet<QByteArray> uploadedScriptHashes;
+  };
+  QList<ServiceEndpoint> m_endpoints;
+  // schemaId -> 有序 schema；缓存非空时请求 CBOR 头部，头部只携带 schemaId
+  QHash<QString, QVariantMap> m_schemaCache;
+  bool m_schemaFetchPending = false;
+  // 同机交付：服务端在本机时由客户端直接映射结果文件（QTOCCT_LOCAL_TRANSPORT=0 关闭）
+  bool m_localTransport = true;
+  // 服务端的交付目录 (QTOCCT_HANDOFF_DIR，默认 /dev/shm/occt-handoff；
+  // 无 /dev/shm 的平台设为 scripts-service/workspace/handoff)。
+  // 只映射并删除该目录内的交付文件，服务就绪时目录仍不存在则不启用同机交付
+  QString m_handoffDir;
   QQueue<int> m_batchQueue;
   int m_completedTasks = 0;
   PythonSyntaxHighlighter *m_highlighter;
@@ -90,6 +141,19 @@ private:
   double m_bridgePierSpacing = 340.0;
   QElapsedTimer m_batchTimer;
   bool m_isAssembling = false;
+  AssemblyJobGraph m_jobGraph; // 拼装构件及其 out 参数依赖
+  // 多选批量重新生成：按参数组合去重，每组只请求一次，结果分发给组内所有实例
+  struct RegenTarget {
+    Handle(AIS_InteractiveObject) object;
+    double yOffset; // 安放参数不参与分组，结果平移到实例所在位置
+  };
+  struct RegenGroup {
+    QJsonObject args;
+    QList<RegenTarget> targets;
+  };
+  QList<RegenGroup> m_regenGroups;
+  int m_pendingRegenGroups = 0;
+  bool m_isRegenerating = false;
   QList<OCCTWidget::AssemblyPart> m_assemblyParts;
   QList<OCCTWidget::AssemblyPart> m_batchParts;
 };
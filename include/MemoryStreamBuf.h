@@ -0,0 +1,39 @@
+#ifndef MEMORYSTREAMBUF_H
+#define MEMORYSTREAMBUF_H
+
+#include <cstddef>
+#include <streambuf>
+
+// 只读内存输入流缓冲区：直接引用外部内存（QByteArray、映射文件），不做拷贝。
+// 调用方需保证内存在流使用期间有效。
+class MemoryStreamBuf : public std::streambuf {
+public:
+  MemoryStreamBuf(const char *data, std::size_t size) {
+    char *begin = const_cast<char *>(data);
+    setg(begin, begin, begin + size);
+  }
+
+protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override {
+    if (!(which & std::ios_base::in))
+      return pos_type(off_type(-1));
+    char *target = nullptr;
+    if (dir == std::ios_base::beg)
+      target = eback() + off;
+    else if (dir == std::ios_base::cur)
+      target = gptr() + off;
+    else
+      target = egptr() + off;
+    if (target < eback() || target > egptr())
+      return pos_type(off_type(-1));
+    setg(eback(), target, egptr());
+    return pos_type(target - eback());
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+#endif // MEMORYSTREAMBUF_H
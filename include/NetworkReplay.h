@@ -0,0 +1,51 @@
+#ifndef NETWORKREPLAY_H
+#define NETWORKREPLAY_H
+
+#include <QNetworkAccessManager>
+#include <QString>
+
+// 客户端网络管线的录制/回放
+// 录制：请求照常发往服务端，每个成功应答的完整正文（JHB 包）与首字节/总耗时
+//       写入目录，文件名为请求键 (<key>.json 元数据 + <key>.body 正文)。
+// 回放：不访问网络，按请求键读取录制内容，以录制时的耗时或固定延迟分块返回，
+//       用于在无 Python/网络的机器上确定性地测量解码、网格化与显示吞吐。
+// 请求键只取影响应答内容的字段（模型类型、参数、格式、编码），
+// 与是否只发送脚本哈希、是否请求同机交付无关。
+class RecordingNetworkAccessManager : public QNetworkAccessManager {
+  Q_OBJECT
+
+public:
+  explicit RecordingNetworkAccessManager(const QString &directory,
+                                         QObject *parent = nullptr);
+
+protected:
+  QNetworkReply *createRequest(Operation op, const QNetworkRequest &request,
+                               QIODevice *outgoingData) override;
+
+private:
+  QString m_directory;
+};
+
+class ReplayNetworkAccessManager : public QNetworkAccessManager {
+  Q_OBJECT
+
+public:
+  explicit ReplayNetworkAccessManager(const QString &directory,
+                                      QObject *parent = nullptr);
+
+  // latencyMs < 0: 按录制的首字节与传输耗时回放（默认）；
+  // latencyMs >= 0: 固定首字节延迟，正文不限速
+  void setLatency(int latencyMs) { m_latencyMs = latencyMs; }
+  void setChunkSize(int bytes) { m_chunkSize = bytes; }
+
+protected:
+  QNetworkReply *createRequest(Operation op, const QNetworkRequest &request,
+                               QIODevice *outgoingData) override;
+
+private:
+  QString m_directory;
+  int m_latencyMs = -1;
+  int m_chunkSize = 64 * 1024; // 每次 readyRead 交付的字节数
+};
+
+#endif // NETWORKREPLAY_H
@@ -18,6 +18,7 @@
 #include <Geom_Line.hxx>
 #include <Graphic3d_NameOfMaterial.hxx>
 #include <Quantity_Color.hxx>
+#include <gp_Vec.hxx>
 
 #include <QMap>
 #include <QVariant>
@@ -77,11 +78,20 @@ public:
     TopoDS_Shape shape;
     Graphic3d_NameOfMaterial material;
     QVariantMap metadata;
+    gp_Vec offset; // 相对墩位的安放位置，由上游构件的 out 参数推算
   };
   void buildFullBridgeFromParts(const QList<AssemblyPart> &parts, int count,
                                 double spacing);
   void buildFullBridgeFromBatch(const QList<AssemblyPart> &parts);
 
+  // 当前选中的对象 (Shift+单击可多选)
+  QList<Handle(AIS_InteractiveObject)> selectedObjects() const;
+  QVariantMap objectMetadata(const Handle(AIS_InteractiveObject) &object) const;
+  // 原位替换对象的形状：保留材质、颜色与实例位置 (Location)，更新元数据。
+  // 只重新计算显示，不刷新视图，批量替换后由调用方 update()
+  void replaceShape(const Handle(AIS_InteractiveObject) &object,
+                    const TopoDS_Shape &shape, const QVariantMap &metadata);
+
 private:
   TopoDS_Shape makeTextShape(const QString &text, double height,
                              const gp_Pnt &position, double angle = 0.0,
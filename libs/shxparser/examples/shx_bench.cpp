@@ -0,0 +1,293 @@
+/*
+ * Glyph Lookup Benchmark
+ * Times font loading with lazy glyph compilation against compiling every
+ * glyph up front, then getGlyph() on mixed Chinese/ASCII text against a
+ * std::map lookup over the same glyphs (the previous storage layout),
+ * batch layout of pier chainage labels against per-string render() calls,
+ * layoutParallel() on all cores against a single-threaded layoutBatch(),
+ * and UTF-8 -> font code mapping of long mixed strings against decoding
+ * through intermediate buffers (the shape of a QString/locale round trip).
+ *
+ * Usage: shx_bench <shx_file> [iterations]
+ */
+
+#include "ShxParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+static size_t commandBytes(const shx::ShxFont& font) {
+    size_t bytes = 0;
+    for (uint32_t code = 1; code <= 0xFFFF; ++code) {
+        if (const shx::Glyph* glyph = font.getGlyph(code)) {
+            bytes += glyph->commands.memoryBytes();
+        }
+    }
+    return bytes;
+}
+
+// Labels for piers at 32 m spacing, rotated like a curved alignment
+static std::vector<shx::TextRecord> chainageLabels(size_t count = 300) {
+    std::vector<shx::TextRecord> records(count);
+    for (size_t i = 0; i < records.size(); ++i) {
+        double chainage = 323569.30 + i * 32.0;
+        char text[32];
+        std::snprintf(text, sizeof(text), "D1K%d+%06.2f",
+                      static_cast<int>(chainage / 1000), std::fmod(chainage, 1000.0));
+        records[i].text = text;
+        records[i].x = i * 32000.0;
+        records[i].height = 200.0;
+        records[i].angle = 0.05 * i;
+    }
+    return records;
+}
+
+// Previous approach: render() through the virtual renderer, then transform
+static void layoutWithRenderer(const shx::ShxFont& font,
+                               const std::vector<shx::TextRecord>& records,
+                               std::vector<double>& vertices) {
+    shx::PathCollector collector;
+    for (const shx::TextRecord& record : records) {
+        collector.clear();
+        font.render(collector, record.text, record.height);
+        double a = record.angle * 3.14159265358979323846 / 180.0;
+        double c = std::cos(a), s = std::sin(a);
+        for (const shx::DrawCommand& cmd : collector.commands) {
+            double u = cmd.endPoint.x * record.widthFactor, v = cmd.endPoint.y;
+            vertices.push_back(record.x + c * u - s * v);
+            vertices.push_back(record.y + s * u + c * v);
+        }
+    }
+}
+
+static void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += char(cp);
+    } else if (cp < 0x800) {
+        out += char(0xC0 | (cp >> 6));
+        out += char(0x80 | (cp & 0x3F));
+    } else {
+        out += char(0xE0 | (cp >> 12));
+        out += char(0x80 | ((cp >> 6) & 0x3F));
+        out += char(0x80 | (cp & 0x3F));
+    }
+}
+
+// Annotation-like text: half ASCII, half CJK ideographs
+static std::string mixedText(size_t chars, std::mt19937& rng) {
+    std::string text;
+    for (size_t i = 0; i < chars; ++i) {
+        appendUtf8(text, (rng() % 2) ? 0x20 + rng() % 0x5F : 0x4E00 + rng() % 0x51A6);
+    }
+    return text;
+}
+
+// Previous shape: decode into a UTF-32 buffer, encode into a GBK byte
+// buffer, then split the bytes back into codes
+static size_t mapThroughBuffers(const shx::ShxFont& font, const std::string& text) {
+    std::vector<uint32_t> wide;
+    for (size_t pos = 0; pos < text.size();) {
+        wide.push_back(shx::nextCodePoint(text, pos));
+    }
+    std::string bytes;
+    for (uint32_t cp : wide) {
+        uint32_t code = shx::unicodeToGbk(cp);
+        if (code >= 0x100) bytes += char(code >> 8);
+        if (code) bytes += char(code & 0xFF);
+    }
+    size_t found = 0;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        uint32_t code = static_cast<uint8_t>(bytes[i]);
+        if (code >= 0x80 && i + 1 < bytes.size()) {
+            code = (code << 8) | static_cast<uint8_t>(bytes[++i]);
+        }
+        found += font.hasGlyph(code);
+    }
+    return found;
+}
+
+static size_t mapDirect(const shx::ShxFont& font, const std::string& text) {
+    size_t found = 0;
+    for (size_t pos = 0; pos < text.size();) {
+        uint32_t code = font.mapCodePoint(shx::nextCodePoint(text, pos));
+        found += code && font.hasGlyph(code);
+    }
+    return found;
+}
+
+template <typename Lookup>
+static double timeLookups(const std::vector<uint32_t>& text, int iterations,
+                          Lookup lookup, size_t& found) {
+    auto start = std::chrono::steady_clock::now();
+    size_t hits = 0;
+    for (int i = 0; i < iterations; ++i) {
+        for (uint32_t code : text) {
+            const shx::Glyph* glyph = lookup(code);
+            hits += glyph != nullptr;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    found = hits;
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <shx_file> [iterations]\n";
+        return 1;
+    }
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    shx::ShxFont font;
+    auto start = std::chrono::steady_clock::now();
+    if (!font.load(argv[1])) {
+        std::cerr << "Error: " << font.getLastError() << "\n";
+        return 1;
+    }
+    double lazyLoadMs = elapsedMs(start);
+
+    std::vector<uint32_t> ascii, wide;
+    for (uint32_t code = 1; code <= 0xFFFF; ++code) {
+        if (font.hasGlyph(code)) {
+            (code < 0x80 ? ascii : wide).push_back(code);
+        }
+    }
+
+    // Eager: what loading used to cost when every glyph was compiled
+    start = std::chrono::steady_clock::now();
+    font.precompile();
+    double precompileMs = elapsedMs(start);
+    size_t allBytes = commandBytes(font);
+
+    // Baseline: code -> glyph map built from every defined code
+    std::map<uint32_t, const shx::Glyph*> baseline;
+    for (uint32_t code : ascii) baseline[code] = font.getGlyph(code);
+    for (uint32_t code : wide) baseline[code] = font.getGlyph(code);
+
+    // Mixed text: roughly one double-byte character per ASCII character,
+    // plus ~5% codes the font does not define
+    std::mt19937 rng(42);
+    std::vector<uint32_t> text;
+    const size_t length = 4096;
+    text.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+        uint32_t pick = rng() % 100;
+        if (pick < 5 || (ascii.empty() && wide.empty())) {
+            text.push_back(0xE000 + rng() % 0x100);
+        } else if ((pick < 50 && !ascii.empty()) || wide.empty()) {
+            text.push_back(ascii[rng() % ascii.size()]);
+        } else {
+            text.push_back(wide[rng() % wide.size()]);
+        }
+    }
+
+    size_t foundMap = 0, foundTable = 0;
+    // Warm up both paths once before timing
+    timeLookups(text, 1, [&](uint32_t c) { return font.getGlyph(c); }, foundTable);
+    double mapNs = timeLookups(text, iterations, [&](uint32_t c) -> const shx::Glyph* {
+        auto it = baseline.find(c);
+        return it != baseline.end() ? it->second : nullptr;
+    }, foundMap);
+    double tableNs = timeLookups(text, iterations,
+                                 [&](uint32_t c) { return font.getGlyph(c); },
+                                 foundTable);
+
+    double lookups = double(text.size()) * iterations;
+    std::cout << "Font: " << argv[1] << "\n";
+    std::cout << "Glyphs: " << font.getGlyphCount() << " (ASCII " << ascii.size()
+              << ", double-byte " << wide.size() << ")\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Load (lazy)  " << std::setw(8) << lazyLoadMs << " ms\n";
+    std::cout << "Precompile   " << std::setw(8) << precompileMs << " ms, "
+              << allBytes / 1024 << " KiB of commands\n\n";
+    std::cout << "Lookups: " << static_cast<size_t>(lookups) << "\n";
+    std::cout << "std::map     " << std::setw(8) << mapNs / lookups << " ns/lookup\n";
+    std::cout << "page table   " << std::setw(8) << tableNs / lookups << " ns/lookup\n";
+    std::cout << "speedup      " << std::setw(8) << mapNs / tableNs << "x\n";
+
+    // Batch layout of chainage labels
+    std::vector<shx::TextRecord> labels = chainageLabels();
+    const int rounds = 50;
+    std::vector<double> rendered;
+    shx::TextMesh mesh;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        rendered.clear();
+        layoutWithRenderer(font, labels, rendered);
+    }
+    double renderMs = elapsedMs(start) / rounds;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        mesh.clear();
+        font.layoutBatch(labels, mesh);
+    }
+    double batchMs = elapsedMs(start) / rounds;
+
+    std::cout << "\nLabels: " << labels.size() << " (" << mesh.indices.size() / 2
+              << " segments, " << mesh.vertexCount() << " vertices)\n";
+    std::cout << "render()     " << std::setw(8) << renderMs << " ms\n";
+    std::cout << "layoutBatch  " << std::setw(8) << batchMs << " ms\n";
+
+    // A whole bridge's labels from one shared font on every core
+    std::vector<shx::TextRecord> bridge = chainageLabels(20000);
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    mesh.clear();
+    font.layoutBatch(bridge, mesh); // size the buffers once
+    start = std::chrono::steady_clock::now();
+    mesh.clear();
+    font.layoutBatch(bridge, mesh);
+    double serialMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    mesh.clear();
+    font.layoutParallel(bridge, mesh);
+    double parallelMs = elapsedMs(start);
+
+    std::cout << "\nLabels: " << bridge.size() << " (" << cores << " threads)\n";
+    std::cout << "serial       " << std::setw(8) << serialMs << " ms\n";
+    std::cout << "parallel     " << std::setw(8) << parallelMs << " ms\n";
+
+    // UTF-8 -> font codes on long mixed strings
+    std::vector<std::string> strings;
+    for (int i = 0; i < 64; ++i) {
+        strings.push_back(mixedText(1024, rng));
+    }
+    size_t bytes = 0, foundBuffers = 0, foundDirect = 0;
+    for (const std::string& str : strings) bytes += str.size();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        for (const std::string& str : strings) foundBuffers += mapThroughBuffers(font, str);
+    }
+    double buffersMs = elapsedMs(start) / rounds;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        for (const std::string& str : strings) foundDirect += mapDirect(font, str);
+    }
+    double directMs = elapsedMs(start) / rounds;
+
+    std::cout << "\nMixed text: " << strings.size() << " x 1024 chars ("
+              << bytes / 1024 << " KiB UTF-8, " << foundDirect / rounds
+              << " glyphs found)\n";
+    std::cout << "buffers      " << std::setw(8) << buffersMs << " ms\n";
+    std::cout << "direct       " << std::setw(8) << directMs << " ms\n";
+
+    if (foundMap != foundTable) {
+        std::cerr << "Mismatch: map found " << foundMap << ", table found "
+                  << foundTable << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -11,11 +11,14 @@
 #ifndef SHX_PARSER_H
 #define SHX_PARSER_H
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 
@@ -38,7 +41,7 @@ enum class ShxFontType {
 /**
  * @brief Drawing command type
  */
-enum class CommandType {
+enum class CommandType : uint8_t {
   MoveTo,  // Move to position (no drawing)
   LineTo,  // Draw line to position
   ArcTo,   // Draw arc to position
@@ -110,16 +113,182 @@ struct DrawCommand {
   }
 };
 
+/**
+ * @brief Non-owning view of a contiguous array
+ */
+template <typename T> class ArrayView {
+public:
+  ArrayView() = default;
+  ArrayView(const T *data, size_t size) : data_(data), size_(size) {}
+
+  const T *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  const T &operator[](size_t i) const { return data_[i]; }
+
+private:
+  const T *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+/**
+ * @brief Raw SHX bytes of a glyph
+ *
+ * Points into the font's file mapping (or its single copy of a memory
+ * buffer) and stays valid for the lifetime of the owning ShxFont.
+ */
+using ByteSpan = ArrayView<uint8_t>;
+
+/**
+ * @brief Compiled glyph commands in structure-of-arrays form
+ *
+ * One opcode byte per command, the end points as a flat x/y float stream,
+ * and control points (arcs) and sub-shape IDs in their own streams, so a
+ * line-to costs 9 bytes instead of a full DrawCommand. Iteration yields
+ * DrawCommand values, keeping the container interface of the previous
+ * std::vector<DrawCommand>.
+ *
+ * Streams are either owned (compiled in process) or borrowed from a mapped
+ * font cache; borrowed streams live as long as the owning ShxFont.
+ */
+class CommandStream {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = DrawCommand;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = DrawCommand;
+
+    const_iterator() = default;
+    const_iterator(const CommandStream *stream, size_t index)
+        : stream_(stream), index_(index) {}
+
+    DrawCommand operator*() const {
+      return stream_->make(index_, control_, subShape_);
+    }
+
+    const_iterator &operator++() {
+      CommandType type = stream_->ops_[index_];
+      control_ += (type == CommandType::ArcTo);
+      subShape_ += (type == CommandType::SubShape);
+      ++index_;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const const_iterator &other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return index_ != other.index_;
+    }
+
+  private:
+    const CommandStream *stream_ = nullptr;
+    size_t index_ = 0;
+    size_t control_ = 0;  // arcs before index_
+    size_t subShape_ = 0; // sub-shapes before index_
+  };
+
+  CommandStream() = default;
+  CommandStream(const CommandStream &other);
+  CommandStream &operator=(const CommandStream &other);
+  CommandStream(CommandStream &&) noexcept = default;
+  CommandStream &operator=(CommandStream &&) noexcept = default;
+
+  /// View over externally owned streams (points/controls hold x, y pairs)
+  static CommandStream borrow(ArrayView<CommandType> ops,
+                              ArrayView<float> points,
+                              ArrayView<float> controls,
+                              ArrayView<uint16_t> subShapes);
+
+  void push_back(const DrawCommand &cmd);
+  void clear();
+  void shrink_to_fit();
+
+  size_t size() const { return ops_.size(); }
+  bool empty() const { return ops_.empty(); }
+
+  /// Random access walks the preceding opcodes; prefer iteration
+  DrawCommand operator[](size_t index) const;
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, ops_.size()); }
+
+  // Raw streams: opcodes, end points (x0, y0, x1, y1, ...), arc control
+  // points in the same layout, and sub-shape IDs
+  ArrayView<CommandType> opcodes() const { return ops_; }
+  ArrayView<float> points() const { return points_; }
+  ArrayView<float> controls() const { return controls_; }
+  ArrayView<uint16_t> subShapes() const { return subShapes_; }
+
+  /// Heap bytes owned by the streams (0 when borrowed)
+  size_t memoryBytes() const;
+
+private:
+  DrawCommand make(size_t index, size_t control, size_t subShape) const;
+  void syncViews();
+
+  ArrayView<CommandType> ops_;
+  ArrayView<float> points_;
+  ArrayView<float> controls_;
+  ArrayView<uint16_t> subShapes_;
+  bool borrowed_ = false;
+
+  std::vector<CommandType> ownedOps_;
+  std::vector<float> ownedPoints_;
+  std::vector<float> ownedControls_;
+  std::vector<uint16_t> ownedSubShapes_;
+};
+
+/**
+ * @brief Axis-aligned bounding box
+ */
+struct Bounds {
+  double minX = 0.0;
+  double minY = 0.0;
+  double maxX = 0.0;
+  double maxY = 0.0;
+  bool valid = false; // false until a point is added
+
+  void add(double x, double y) {
+    if (!valid) {
+      minX = maxX = x;
+      minY = maxY = y;
+      valid = true;
+      return;
+    }
+    minX = x < minX ? x : minX;
+    maxX = x > maxX ? x : maxX;
+    minY = y < minY ? y : minY;
+    maxY = y > maxY ? y : maxY;
+  }
+
+  double width() const { return valid ? maxX - minX : 0.0; }
+  double height() const { return valid ? maxY - minY : 0.0; }
+};
+
 /**
  * @brief Glyph data
  */
 struct Glyph {
   uint32_t code = 0;                 // Character code
   std::string name;                  // Glyph name
-  std::vector<DrawCommand> commands; // Drawing commands
-  std::vector<uint8_t> rawData;      // Raw SHX bytes (for delayed compilation)
+  CommandStream commands;            // Drawing commands
+  ByteSpan rawData;                  // Raw SHX bytes (for delayed compilation)
   double width = 0.0;                // Glyph width
   double height = 0.0;               // Glyph height
+  Bounds inkBounds; // Exact extent of the drawn strokes (arcs included),
+                    // glyph units; invalid when the glyph only moves the pen
 
   bool isEmpty() const { return commands.empty(); }
 };
@@ -167,12 +336,74 @@ public:
   void clear() { commands.clear(); }
 };
 
+//=============================================================================
+// Batch Layout
+//=============================================================================
+
+/**
+ * @brief One string to lay out in a batch
+ *
+ * The glyph outline is stretched by widthFactor, rotated by angle and moved
+ * to (x, y), in that order.
+ */
+struct TextRecord {
+  std::string text;         // UTF-8, mapped to codes as in render()
+  double x = 0.0;           // Insertion point
+  double y = 0.0;
+  double height = 1.0;      // Text height (font size)
+  double angle = 0.0;       // Rotation in degrees, counter-clockwise
+  double widthFactor = 1.0; // Horizontal stretch
+};
+
+/**
+ * @brief Line segments of a batch of laid out strings
+ *
+ * All strings share one vertex buffer and one index buffer (index pairs,
+ * one pair per segment). Consecutive segments of a stroke share vertices.
+ * layoutBatch() appends, so one mesh can collect several fonts.
+ */
+struct TextMesh {
+  struct Range {
+    uint32_t firstIndex = 0; // Into indices
+    uint32_t indexCount = 0;
+    double advance = 0.0;    // Unrotated text width in world units
+  };
+
+  std::vector<double> vertices;  // x0, y0, x1, y1, ...
+  std::vector<uint32_t> indices; // Segment index pairs
+  std::vector<Range> ranges;     // One per laid out TextRecord
+
+  size_t vertexCount() const { return vertices.size() / 2; }
+
+  void clear() {
+    vertices.clear();
+    indices.clear();
+    ranges.clear();
+  }
+};
+
+/**
+ * @brief Batch layout options
+ */
+struct LayoutOptions {
+  int arcSegments = 4; // Chords per compiled arc segment (at most 45 deg)
+};
+
 //=============================================================================
 // SHX Font Parser
 //=============================================================================
 
 /**
  * @brief SHX font file parser
+ *
+ * Thread safety: loading (load, loadFromMemory, loadCached), the setters and
+ * moves must not overlap any other use of the same font. Once loading has
+ * finished, every const member may be called concurrently from any number
+ * of threads on one shared instance. The loaded font is immutable except
+ * for lazily compiled glyph commands, and each glyph is compiled exactly
+ * once under a std::once_flag, so a returned Glyph never changes afterwards.
+ * Renderers and meshes passed in are owned by the caller and must not be
+ * shared between concurrent calls.
  */
 class ShxFont {
 public:
@@ -189,6 +420,10 @@ public:
 
   /**
    * @brief Load SHX font from file
+   *
+   * The file is memory-mapped and glyphs reference their bytes in place;
+   * if mapping fails it is read into memory instead.
+   *
    * @param filename SHX file path
    * @return true on success
    */
@@ -196,24 +431,65 @@ public:
 
   /**
    * @brief Load SHX font from memory
+   *
+   * The buffer is copied once, so it may be released after this returns.
+   *
    * @param data File data
    * @param size Data size
    * @return true on success
    */
   bool loadFromMemory(const uint8_t *data, size_t size);
 
+  /**
+   * @brief Load SHX font through a precompiled cache file
+   *
+   * If cacheFile matches the source bytes of filename and this library's
+   * cache format, glyph commands are used in place from the mapped cache
+   * without parsing or compiling. Otherwise the font is loaded from filename
+   * and the cache is (re)written, best effort.
+   *
+   * @param filename SHX file path
+   * @param cacheFile Cache path, see defaultCachePath()
+   * @return true on success
+   */
+  bool loadCached(const std::string &filename, const std::string &cacheFile);
+
+  /**
+   * @brief Write a precompiled cache of the loaded font
+   *
+   * Compiles every glyph first. The cache is written to a temporary file
+   * and renamed into place.
+   *
+   * @return true on success
+   */
+  bool saveCache(const std::string &cacheFile) const;
+
   /**
    * @brief Get glyph
+   *
+   * Glyph commands are compiled on the first lookup of each code; see the
+   * class notes on concurrent use.
+   *
    * @param code Character code
    * @return Glyph pointer, nullptr if not found
    */
   const Glyph *getGlyph(uint32_t code) const;
 
   /**
-   * @brief Check if glyph exists
+   * @brief Font code of a Unicode code point
+   *
+   * BigFonts are indexed by GBK (code page 936) codes: non-ASCII code points
+   * go through a built-in GBK table, and the lead byte must fall inside one
+   * of the font's double-byte ranges. Other fonts are indexed by code point.
+   * render(), measureText() and layoutBatch() map text this way. Independent
+   * of the system locale and does not allocate.
+   *
+   * @return Code for getGlyph(), 0 if the font cannot encode the character
    */
+  uint32_t mapCodePoint(uint32_t codePoint) const;
+
   /**
-   * @brief Check if glyph exists
+   * @brief Check if glyph exists (does not compile it)
    */
   bool hasGlyph(uint32_t code) const;
 
@@ -238,6 +514,49 @@ public:
    */
   double measureText(const std::string &text, double fontSize = 1.0) const;
 
+  /**
+   * @brief Compile every glyph now instead of on first use
+   *
+   * Trades load time and memory for predictable lookup latency.
+   */
+  void precompile() const;
+
+  /**
+   * @brief Compile arcs as line segments
+   *
+   * With a tolerance > 0, every arc is flattened at compile time into chords
+   * that deviate at most tolerance (in font units) from the true arc, so the
+   * compiled commands contain only MoveTo/LineTo/SubShape. 0 (the default)
+   * keeps ArcTo commands. Takes effect for the next load; caches record the
+   * tolerance they were built with.
+   */
+  void setArcTolerance(double tolerance);
+  double getArcTolerance() const;
+
+  /**
+   * @brief Lay out many strings into one vertex/index buffer
+   *
+   * Equivalent to render() per record followed by widthFactor, angle and
+   * position transforms, but in a single pass over the compiled command
+   * streams without per-command virtual calls. Arcs are emitted as
+   * options.arcSegments chords. Results are appended to mesh.
+   */
+  void layoutBatch(const std::vector<TextRecord> &records, TextMesh &mesh,
+                   const LayoutOptions &options = LayoutOptions()) const;
+
+  /**
+   * @brief layoutBatch() spread over several threads
+   *
+   * Records are split into contiguous chunks that are laid out concurrently
+   * from this font, then appended to mesh in record order, so the result is
+   * identical to layoutBatch(). Small batches use fewer threads.
+   *
+   * @param threads Worker count, 0 for std::thread::hardware_concurrency()
+   */
+  void layoutParallel(const std::vector<TextRecord> &records, TextMesh &mesh,
+                      const LayoutOptions &options = LayoutOptions(),
+                      unsigned threads = 0) const;
+
   // Property accessors
   ShxFontType getFontType() const;
   const std::string &getFontName() const;
@@ -245,6 +564,12 @@ public:
   double getDescender() const;
   size_t getGlyphCount() const;
 
+  /**
+   * @brief Lead-byte ranges (inclusive) of a BigFont's double-byte codes
+   */
+  const std::vector<std::pair<uint16_t, uint16_t>> &
+  getDoubleByteRanges() const;
+
   /**
    * @brief Get last error message
    */
@@ -269,6 +594,42 @@ private:
  */
 const char *getVersion();
 
+/**
+ * @brief Decode the UTF-8 code point at pos and advance pos past it
+ *
+ * pos must be less than text.size(). A malformed or truncated sequence
+ * decodes as U+FFFD; decoding resumes at the first byte that cannot
+ * continue it. Does not allocate.
+ */
+uint32_t nextCodePoint(const std::string &text, size_t &pos);
+
+/**
+ * @brief GBK (code page 936) code of a Unicode code point
+ *
+ * Built-in table, independent of the system locale. ASCII maps to itself.
+ *
+ * @return Double-byte code (lead byte high), 0 if GBK has no such character
+ */
+uint32_t unicodeToGbk(uint32_t codePoint);
+
+/**
+ * @brief Cache path next to a font file ("fonts/hztxt.SHX" -> "fonts/hztxt.shxc")
+ */
+std::string defaultCachePath(const std::string &filename);
+
+/**
+ * @brief Flatten an arc into chords within a tolerance
+ *
+ * The arc runs from (x0, y0) through the on-arc point (mx, my) to (x1, y1),
+ * like a compiled ArcTo. Appends the chord end points (x, y pairs, not the
+ * start point) to out; the last one is exactly (x1, y1). Collinear input
+ * yields the single end point.
+ *
+ * @return Number of points appended
+ */
+size_t flattenArc(double x0, double y0, double mx, double my, double x1,
+                  double y1, double tolerance, std::vector<double> &out);
+
 /**
  * @brief Check if file is a valid SHX file
  */
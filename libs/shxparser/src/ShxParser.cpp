@@ -9,19 +9,40 @@
 
 #define _USE_MATH_DEFINES
 #include <algorithm>
+#include <bitset>
 #include <cmath>
+#include <cstdio>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <mutex>
 #include <stack>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../include/ShxParser.h"
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // M_PI definition for MSVC
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -69,6 +90,26 @@ static const double DIR_VECTORS[16][2] = {
     {1.0, -0.5}   // 15: ESE (1, -0.5)
 };
 
+// cos/sin of multiples of 22.5 degrees: octant arc end points lie on
+// multiples of 45 degrees and their control points halfway between
+static const double HALF_OCTANT[16][2] = {
+    {1.0, 0.0},
+    {0.92387953251128674, 0.38268343236508966},
+    {0.70710678118654752, 0.70710678118654752},
+    {0.38268343236508966, 0.92387953251128674},
+    {0.0, 1.0},
+    {-0.38268343236508966, 0.92387953251128674},
+    {-0.70710678118654752, 0.70710678118654752},
+    {-0.92387953251128674, 0.38268343236508966},
+    {-1.0, 0.0},
+    {-0.92387953251128674, -0.38268343236508966},
+    {-0.70710678118654752, -0.70710678118654752},
+    {-0.38268343236508966, -0.92387953251128674},
+    {0.0, -1.0},
+    {0.38268343236508966, -0.92387953251128674},
+    {0.70710678118654752, -0.70710678118654752},
+    {0.92387953251128674, -0.38268343236508966}};
+
 // Special command codes
 enum SpecialCommand : uint8_t {
   CMD_END_OF_SHAPE = 0x00,
@@ -117,53 +158,307 @@ static inline uint32_t readUInt32LE(const uint8_t *data, size_t &pos) {
   return result;
 }
 
-static std::vector<uint32_t> utf8ToCodePoints(const std::string &str) {
-  std::vector<uint32_t> result;
-  size_t i = 0;
-  while (i < str.size()) {
-    uint32_t cp = 0;
-    uint8_t c = static_cast<uint8_t>(str[i]);
-
-    if ((c & 0x80) == 0) {
-      cp = c;
-      i += 1;
-    } else if ((c & 0xE0) == 0xC0) {
-      cp = (c & 0x1F) << 6;
-      if (i + 1 < str.size()) {
-        cp |= (static_cast<uint8_t>(str[i + 1]) & 0x3F);
-      }
-      i += 2;
-    } else if ((c & 0xF0) == 0xE0) {
-      cp = (c & 0x0F) << 12;
-      if (i + 1 < str.size()) {
-        cp |= (static_cast<uint8_t>(str[i + 1]) & 0x3F) << 6;
-      }
-      if (i + 2 < str.size()) {
-        cp |= (static_cast<uint8_t>(str[i + 2]) & 0x3F);
-      }
-      i += 3;
-    } else if ((c & 0xF8) == 0xF0) {
-      cp = (c & 0x07) << 18;
-      if (i + 1 < str.size()) {
-        cp |= (static_cast<uint8_t>(str[i + 1]) & 0x3F) << 12;
-      }
-      if (i + 2 < str.size()) {
-        cp |= (static_cast<uint8_t>(str[i + 2]) & 0x3F) << 6;
-      }
-      if (i + 3 < str.size()) {
-        cp |= (static_cast<uint8_t>(str[i + 3]) & 0x3F);
-      }
-      i += 4;
-    } else {
-      i += 1;
-      continue;
+// Angle normalised to [0, 2pi)
+static inline double ccwAngle(double angle) {
+  double wrapped = std::fmod(angle, 2.0 * M_PI);
+  return wrapped < 0 ? wrapped + 2.0 * M_PI : wrapped;
+}
+
+// Unicode -> GBK, generated by tools/gen_gbk_table.py
+#include "GbkTable.inc"
+
+//=============================================================================
+// CommandStream Implementation
+//=============================================================================
+
+CommandStream::CommandStream(const CommandStream &other)
+    : ops_(other.ops_), points_(other.points_), controls_(other.controls_),
+      subShapes_(other.subShapes_), borrowed_(other.borrowed_),
+      ownedOps_(other.ownedOps_), ownedPoints_(other.ownedPoints_),
+      ownedControls_(other.ownedControls_),
+      ownedSubShapes_(other.ownedSubShapes_) {
+  if (!borrowed_)
+    syncViews();
+}
+
+CommandStream &CommandStream::operator=(const CommandStream &other) {
+  if (this != &other) {
+    CommandStream copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+CommandStream CommandStream::borrow(ArrayView<CommandType> ops,
+                                    ArrayView<float> points,
+                                    ArrayView<float> controls,
+                                    ArrayView<uint16_t> subShapes) {
+  CommandStream stream;
+  stream.ops_ = ops;
+  stream.points_ = points;
+  stream.controls_ = controls;
+  stream.subShapes_ = subShapes;
+  stream.borrowed_ = true;
+  return stream;
+}
+
+void CommandStream::push_back(const DrawCommand &cmd) {
+  if (borrowed_)
+    clear();
+  ownedOps_.push_back(cmd.type);
+  ownedPoints_.push_back(static_cast<float>(cmd.endPoint.x));
+  ownedPoints_.push_back(static_cast<float>(cmd.endPoint.y));
+  if (cmd.type == CommandType::ArcTo) {
+    ownedControls_.push_back(static_cast<float>(cmd.controlPoint.x));
+    ownedControls_.push_back(static_cast<float>(cmd.controlPoint.y));
+  } else if (cmd.type == CommandType::SubShape) {
+    ownedSubShapes_.push_back(cmd.subShapeId);
+  }
+  syncViews();
+}
+
+void CommandStream::clear() {
+  ownedOps_.clear();
+  ownedPoints_.clear();
+  ownedControls_.clear();
+  ownedSubShapes_.clear();
+  borrowed_ = false;
+  syncViews();
+}
+
+void CommandStream::shrink_to_fit() {
+  ownedOps_.shrink_to_fit();
+  ownedPoints_.shrink_to_fit();
+  ownedControls_.shrink_to_fit();
+  ownedSubShapes_.shrink_to_fit();
+  if (!borrowed_)
+    syncViews();
+}
+
+void CommandStream::syncViews() {
+  ops_ = ArrayView<CommandType>(ownedOps_.data(), ownedOps_.size());
+  points_ = ArrayView<float>(ownedPoints_.data(), ownedPoints_.size());
+  controls_ = ArrayView<float>(ownedControls_.data(), ownedControls_.size());
+  subShapes_ =
+      ArrayView<uint16_t>(ownedSubShapes_.data(), ownedSubShapes_.size());
+}
+
+DrawCommand CommandStream::operator[](size_t index) const {
+  size_t control = 0, subShape = 0;
+  for (size_t i = 0; i < index; ++i) {
+    control += (ops_[i] == CommandType::ArcTo);
+    subShape += (ops_[i] == CommandType::SubShape);
+  }
+  return make(index, control, subShape);
+}
+
+size_t CommandStream::memoryBytes() const {
+  return ownedOps_.capacity() * sizeof(CommandType) +
+         ownedPoints_.capacity() * sizeof(float) +
+         ownedControls_.capacity() * sizeof(float) +
+         ownedSubShapes_.capacity() * sizeof(uint16_t);
+}
+
+DrawCommand CommandStream::make(size_t index, size_t control,
+                                size_t subShape) const {
+  DrawCommand cmd;
+  cmd.type = ops_[index];
+  cmd.endPoint = Point2D(points_[2 * index], points_[2 * index + 1]);
+  if (cmd.type == CommandType::ArcTo) {
+    cmd.controlPoint =
+        Point2D(controls_[2 * control], controls_[2 * control + 1]);
+  } else if (cmd.type == CommandType::SubShape) {
+    cmd.subShapeId = subShapes_[subShape];
+  }
+  return cmd;
+}
+
+//=============================================================================
+// Memory-Mapped File
+//=============================================================================
+
+// Read-only mapping of a whole file; glyph byte spans point into it
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      view = other.view;
+      length = other.length;
+      other.view = nullptr;
+      other.length = 0;
     }
+    return *this;
+  }
+
+  bool open(const std::string &filename);
+  void close();
+
+  const uint8_t *data() const { return view; }
+  size_t size() const { return length; }
 
-    result.push_back(cp);
+private:
+  const uint8_t *view = nullptr;
+  size_t length = 0;
+};
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
   }
-  return result;
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping)
+    return false;
+
+  // The view keeps the mapping object alive
+  void *address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!address)
+    return false;
+
+  view = static_cast<const uint8_t *>(address);
+  length = static_cast<size_t>(fileSize.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (view)
+    UnmapViewOfFile(view);
+  view = nullptr;
+  length = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED)
+    return false;
+
+  view = static_cast<const uint8_t *>(address);
+  length = static_cast<size_t>(info.st_size);
+  return true;
 }
 
+void MappedFile::close() {
+  if (view)
+    munmap(const_cast<uint8_t *>(view), length);
+  view = nullptr;
+  length = 0;
+}
+
+#endif
+
+//=============================================================================
+// Glyph Table
+//=============================================================================
+
+// Dense two-level page table over the 16-bit code space used by all SHX
+// formats. The high byte selects a page, the low byte a slot holding an index
+// into contiguous glyph storage, so lookups are two array reads. Pages are
+// allocated only for high bytes that occur (ASCII fonts use one page, GB2312
+// big fonts about 90). Each glyph carries a once-flag so its commands can be
+// compiled lazily from concurrent const lookups.
+class GlyphTable {
+public:
+  GlyphTable() : pageIndex(PAGE_COUNT, NO_PAGE) {}
+
+  const Glyph *find(uint32_t code) const {
+    uint32_t slot = slotOf(code);
+    return slot == EMPTY_SLOT ? nullptr : &glyphs[slot];
+  }
+
+  Glyph *find(uint32_t code) {
+    uint32_t slot = slotOf(code);
+    return slot == EMPTY_SLOT ? nullptr : &glyphs[slot];
+  }
+
+  // Inserts or replaces the glyph for code (later definitions win)
+  void insert(uint32_t code, Glyph &&glyph) {
+    if (code > MAX_CODE)
+      return;
+    uint32_t &page = pageIndex[code >> 8];
+    if (page == NO_PAGE) {
+      page = static_cast<uint32_t>(slots.size() >> 8);
+      slots.resize(slots.size() + PAGE_SIZE, EMPTY_SLOT);
+    }
+    uint32_t &slot = slots[(page << 8) | (code & 0xFF)];
+    if (slot == EMPTY_SLOT) {
+      slot = static_cast<uint32_t>(glyphs.size());
+      glyphs.push_back(std::move(glyph));
+    } else {
+      glyphs[slot] = std::move(glyph);
+    }
+  }
+
+  // Called once parsing is done; glyph storage must not change afterwards
+  void seal() { compileFlags.reset(new std::once_flag[glyphs.size()]); }
+
+  std::once_flag &compileFlag(const Glyph &glyph) {
+    return compileFlags[&glyph - glyphs.data()];
+  }
+
+  bool empty() const { return glyphs.empty(); }
+  size_t size() const { return glyphs.size(); }
+
+  std::vector<Glyph>::iterator begin() { return glyphs.begin(); }
+  std::vector<Glyph>::iterator end() { return glyphs.end(); }
+
+private:
+  uint32_t slotOf(uint32_t code) const {
+    if (code > MAX_CODE)
+      return EMPTY_SLOT;
+    uint32_t page = pageIndex[code >> 8];
+    if (page == NO_PAGE)
+      return EMPTY_SLOT;
+    return slots[(page << 8) | (code & 0xFF)];
+  }
+
+  static constexpr uint32_t MAX_CODE = 0xFFFF;
+  static constexpr uint32_t PAGE_COUNT = 256;
+  static constexpr uint32_t PAGE_SIZE = 256;
+  static constexpr uint32_t NO_PAGE = UINT32_MAX;
+  static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+  std::vector<uint32_t> pageIndex; // high byte -> page number
+  std::vector<uint32_t> slots;     // page * 256 + low byte -> glyph index
+  std::vector<Glyph> glyphs;       // in file order
+  std::unique_ptr<std::once_flag[]> compileFlags;
+};
+
 //=============================================================================
 // ShxFont::Impl Implementation
 //=============================================================================
@@ -175,46 +470,119 @@ public:
 
   bool load(const std::string &filename);
   bool loadFromMemory(const uint8_t *data, size_t size);
+  bool loadCached(const std::string &filename, const std::string &cacheFile);
+  bool saveCache(const std::string &cacheFile) const;
 
   const Glyph *getGlyph(uint32_t code) const;
   bool hasGlyph(uint32_t code) const;
+  uint32_t mapCodePoint(uint32_t codePoint) const;
+  const Glyph *glyphForCodePoint(uint32_t codePoint) const;
 
   void render(IPathRenderer &renderer, const std::string &text, double fontSize,
               double x, double y) const;
 
   void renderGlyph(IPathRenderer &renderer, const Glyph *glyph, double scale,
-                   double originX, double originY) const;
+                   double originX, double originY,
+                   std::vector<double> &scratch) const;
 
   double measureText(const std::string &text, double fontSize) const;
 
+  void precompile() const;
+
+  void layoutBatch(const TextRecord *records, size_t count, TextMesh &mesh,
+                   const LayoutOptions &options) const;
+  void layoutParallel(const std::vector<TextRecord> &records, TextMesh &mesh,
+                      const LayoutOptions &options, unsigned threads) const;
+
   // Properties
   ShxFontType fontType = ShxFontType::Unknown;
   std::string fontName;
   double baseHeight = 0.0;
   double descender = 0.0;
   double defWidth = 0.0;
+  double arcTolerance = 0.0; // Requested by setArcTolerance()
   std::string lastError;
   bool valid = false;
 
-  // Glyph data
-  std::map<uint32_t, Glyph> glyphs;
+  // Glyph data; mutable because commands are compiled on first lookup
+  mutable GlyphTable glyphs;
+
+  // BigFont lead-byte ranges as stored in the file, and the same as a set
+  std::vector<std::pair<uint16_t, uint16_t>> doubleByteRanges;
+  std::bitset<256> leadBytes;
 
 private:
+  // Backing bytes for glyph rawData spans: the file mapping, or a single
+  // owned copy when loading from memory or when mapping is unavailable
+  MappedFile mapping;
+  std::vector<uint8_t> ownedData;
+
+  // Font loaded from a cache: command streams borrow from this mapping
+  MappedFile cacheMapping;
+  uint64_t cacheSourceHash = 0;
+  uint64_t cacheSourceSize = 0;
+
+  // Tolerance the loaded glyphs compile with, fixed at load so lazily
+  // compiled glyphs agree; > 0 flattens arcs into chords
+  double compileTolerance = 0.0;
+
+  void reset();
+  bool parse(const uint8_t *data, size_t size);
+  bool readCache(const std::string &cacheFile, uint64_t sourceHash,
+                 uint64_t sourceSize);
+  bool writeCache(const std::string &cacheFile, uint64_t sourceHash,
+                  uint64_t sourceSize) const;
+
   bool parseHeader(const uint8_t *data, size_t size, size_t &pos);
   bool parseShapes(const uint8_t *data, size_t size, size_t pos);
   bool parseBigFont(const uint8_t *data, size_t size, size_t pos);
   bool parseUniFont(const uint8_t *data, size_t size, size_t pos);
 
   void parseGlyphData(const uint8_t *data, size_t dataSize, Glyph &glyph);
+  void setDoubleByteRanges(
+      std::vector<std::pair<uint16_t, uint16_t>> ranges);
 
-  void compileAll();
-  void compileGlyph(const std::vector<uint8_t> &sourceData,
-                    std::vector<DrawCommand> &targetCommands,
+  Glyph *compiled(Glyph *glyph) const;
+  void compileCommands(Glyph &glyph) const;
+  void compileGlyph(ByteSpan sourceData,
+                    CommandStream &targetCommands,
                     std::stack<Point2D> &posStack, bool &penDown, double scale,
-                    double x, double y, int depth);
+                    double x, double y, int depth) const;
+
+  // Arc emission shared by the arc opcodes; (x, y) is the pen position and
+  // is advanced to the end of the arc
+  void appendArc(CommandStream &target, bool penDown, double sx, double sy,
+                 double mx, double my, double ex, double ey) const;
+  void appendCircularArc(CommandStream &target, bool penDown, double cx,
+                         double cy, double r, double ux, double uy,
+                         double span, double &x, double &y,
+                         const Point2D *exactEnd = nullptr) const;
+  void appendBulge(CommandStream &target, bool penDown, int dx, int dy,
+                   int bulgeInt, double scale, double &x, double &y) const;
 };
 
+void ShxFont::Impl::reset() {
+  // Spans from a previous load point into the buffers released here
+  glyphs = GlyphTable();
+  mapping.close();
+  ownedData.clear();
+  ownedData.shrink_to_fit();
+  cacheMapping.close();
+  cacheSourceHash = 0;
+  cacheSourceSize = 0;
+  compileTolerance = arcTolerance;
+  doubleByteRanges.clear();
+  leadBytes.reset();
+  valid = false;
+}
+
 bool ShxFont::Impl::load(const std::string &filename) {
+  reset();
+  if (mapping.open(filename)) {
+    return parse(mapping.data(), mapping.size());
+  }
+
+  // Mapping unavailable (e.g. empty file or unsupported filesystem)
   std::ifstream file(filename, std::ios::binary | std::ios::ate);
   if (!file.is_open()) {
     lastError = "Cannot open file: " + filename;
@@ -225,16 +593,22 @@ bool ShxFont::Impl::load(const std::string &filename) {
   std::streamsize size = file.tellg();
   file.seekg(0, std::ios::beg);
 
-  std::vector<uint8_t> buffer(static_cast<size_t>(size));
-  if (!file.read(reinterpret_cast<char *>(buffer.data()), size)) {
+  ownedData.resize(static_cast<size_t>(size));
+  if (!file.read(reinterpret_cast<char *>(ownedData.data()), size)) {
     lastError = "Failed to read file: " + filename;
     return false;
   }
 
-  return loadFromMemory(buffer.data(), buffer.size());
+  return parse(ownedData.data(), ownedData.size());
 }
 
 bool ShxFont::Impl::loadFromMemory(const uint8_t *data, size_t size) {
+  reset();
+  ownedData.assign(data, data + size);
+  return parse(ownedData.data(), ownedData.size());
+}
+
+bool ShxFont::Impl::parse(const uint8_t *data, size_t size) {
   if (size < 32) {
     lastError = "File too small to be a valid SHX file";
     return false;
@@ -263,7 +637,7 @@ bool ShxFont::Impl::loadFromMemory(const uint8_t *data, size_t size) {
   }
 
   if (result) {
-    compileAll();
+    glyphs.seal();
   }
 
   valid = result;
@@ -386,7 +760,7 @@ bool ShxFont::Impl::parseShapes(const uint8_t *data, size_t size, size_t pos) {
 
       parseGlyphData(data + pos, entry.length, glyph);
 
-      glyphs[entry.shapeNum] = std::move(glyph);
+      glyphs.insert(entry.shapeNum, std::move(glyph));
 
       pos += entry.length;
     }
@@ -419,13 +793,14 @@ bool ShxFont::Impl::parseBigFont(const uint8_t *data, size_t size, size_t pos) {
   uint32_t totalGlyphs =
       static_cast<uint32_t>(count) + static_cast<uint32_t>(lengthField);
 
-  // Read ranges (for double-byte character detection)
+  // Read ranges (lead bytes of double-byte characters)
   std::vector<std::pair<uint16_t, uint16_t>> ranges;
   for (uint16_t i = 0; i < changeCount && pos + 4 <= size; ++i) {
     uint16_t start = readUInt16LE(data, pos);
     uint16_t end = readUInt16LE(data, pos);
     ranges.emplace_back(start, end);
   }
+  setDoubleByteRanges(std::move(ranges));
 
   // Read glyph index table
   struct GlyphRef {
@@ -483,13 +858,25 @@ bool ShxFont::Impl::parseBigFont(const uint8_t *data, size_t size, size_t pos) {
                        glyph);
       }
 
-      glyphs[ref.index] = std::move(glyph);
+      glyphs.insert(ref.index, std::move(glyph));
     }
   }
 
   return !glyphs.empty();
 }
 
+void ShxFont::Impl::setDoubleByteRanges(
+    std::vector<std::pair<uint16_t, uint16_t>> ranges) {
+  doubleByteRanges = std::move(ranges);
+  leadBytes.reset();
+  for (const auto &range : doubleByteRanges) {
+    for (uint32_t lead = range.first; lead <= range.second && lead < 256;
+         ++lead) {
+      leadBytes.set(lead);
+    }
+  }
+}
+
 bool ShxFont::Impl::parseUniFont(const uint8_t *data, size_t size, size_t pos) {
   if (pos + 6 > size) {
     lastError = "Unexpected end of file in unifont header";
@@ -527,7 +914,7 @@ bool ShxFont::Impl::parseUniFont(const uint8_t *data, size_t size, size_t pos) {
 
     parseGlyphData(data + pos, cmdLen, glyph);
 
-    glyphs[index] = std::move(glyph);
+    glyphs.insert(index, std::move(glyph));
 
     pos += cmdLen;
   }
@@ -540,46 +927,286 @@ void ShxFont::Impl::parseGlyphData(const uint8_t *data, size_t dataSize,
   if (dataSize == 0)
     return;
 
-  // Store raw data for deferred compilation
-  glyph.rawData.assign(data, data + dataSize);
+  // Borrow raw data for deferred compilation; the bytes stay in the mapping
+  glyph.rawData = ByteSpan(data, dataSize);
 }
 
-void ShxFont::Impl::compileAll() {
-  for (auto &pair : glyphs) {
-    Glyph &glyph = pair.second;
-    if (glyph.rawData.empty())
-      continue;
+// Circle through an arc's start, on-arc point and end. sweep is the signed
+// angle from start to end passing the on-arc point (positive = CCW).
+// Returns false for collinear points.
+struct ArcCircle {
+  double cx, cy, r;
+  double start, sweep;
+};
 
-    // Initialize parsing state for this glyph
-    std::stack<Point2D> posStack;
-    bool penDown = true;
-    double scale = 1.0;
-    double x = 0.0, y = 0.0;
-
-    // Start compilation from scratch
-    glyph.commands.clear();
-    compileGlyph(glyph.rawData, glyph.commands, posStack, penDown, scale, x, y,
-                 0);
-
-    // Calculate width/height after compilation
-    if (!glyph.commands.empty()) {
-      double minX = 0, maxX = 0, minY = 0, maxY = 0;
-      for (const auto &cmd : glyph.commands) {
-        minX = std::min(minX, cmd.endPoint.x);
-        maxX = std::max(maxX, cmd.endPoint.x);
-        minY = std::min(minY, cmd.endPoint.y);
-        maxY = std::max(maxY, cmd.endPoint.y);
-      }
-      glyph.width = maxX - minX;
-      glyph.height = maxY - minY;
+static bool arcCircle(double sx, double sy, double mx, double my, double ex,
+                      double ey, ArcCircle &arc) {
+  double d = 2.0 * (sx * (my - ey) + mx * (ey - sy) + ex * (sy - my));
+  if (std::abs(d) < 1e-12)
+    return false;
+  double s2 = sx * sx + sy * sy, m2 = mx * mx + my * my, e2 = ex * ex + ey * ey;
+  arc.cx = (s2 * (my - ey) + m2 * (ey - sy) + e2 * (sy - my)) / d;
+  arc.cy = (s2 * (ex - mx) + m2 * (sx - ex) + e2 * (mx - sx)) / d;
+  arc.r = std::sqrt((sx - arc.cx) * (sx - arc.cx) + (sy - arc.cy) * (sy - arc.cy));
+  arc.start = std::atan2(sy - arc.cy, sx - arc.cx);
+
+  double toMid = ccwAngle(std::atan2(my - arc.cy, mx - arc.cx) - arc.start);
+  double toEnd = ccwAngle(std::atan2(ey - arc.cy, ex - arc.cx) - arc.start);
+  arc.sweep = (toMid <= toEnd) ? toEnd : toEnd - 2.0 * M_PI;
+  return true;
+}
+
+// Extends bounds by the arc from start through mid to end (the compiled
+// control point lies on the arc): both ends plus every axis extreme
+// (0/90/180/270 degrees) that the sweep passes
+static void addArcBounds(Bounds &bounds, double sx, double sy, double mx,
+                         double my, double ex, double ey) {
+  bounds.add(sx, sy);
+  bounds.add(ex, ey);
+
+  ArcCircle arc;
+  if (!arcCircle(sx, sy, mx, my, ex, ey, arc)) {
+    bounds.add(mx, my); // collinear: a straight stroke
+    return;
+  }
+
+  for (int quadrant = 0; quadrant < 4; ++quadrant) {
+    const double *dir = HALF_OCTANT[quadrant * 4];
+    double delta = ccwAngle(quadrant * (M_PI / 2) - arc.start);
+    bool inside = arc.sweep >= 0 ? delta <= arc.sweep
+                                 : (delta == 0.0 || delta >= 2.0 * M_PI + arc.sweep);
+    if (inside) {
+      bounds.add(arc.cx + arc.r * dir[0], arc.cy + arc.r * dir[1]);
+    }
+  }
+}
+
+// Upper bound on chords per arc, whatever the tolerance
+static const int MAX_ARC_CHORDS = 1024;
+
+size_t flattenArc(double x0, double y0, double mx, double my, double x1,
+                  double y1, double tolerance, std::vector<double> &out) {
+  ArcCircle arc;
+  if (!arcCircle(x0, y0, mx, my, x1, y1, arc)) {
+    out.push_back(x1); // collinear: a straight stroke
+    out.push_back(y1);
+    return 1;
+  }
+
+  // A chord over angle d deviates r * (1 - cos(d / 2)) from the arc
+  int n = MAX_ARC_CHORDS;
+  if (tolerance > 0) {
+    double ratio = std::min(tolerance / arc.r, 1.0);
+    double maxStep = 2.0 * std::acos(1.0 - ratio);
+    n = static_cast<int>(
+        std::min(std::ceil(std::abs(arc.sweep) / maxStep), double(n)));
+    n = std::max(1, n);
+  }
+
+  // cos/sin of k * step by rotation, then one independent transform per
+  // point that the compiler can vectorise
+  double step = arc.sweep / n;
+  double cosStep = std::cos(step), sinStep = std::sin(step);
+  double rotCos[MAX_ARC_CHORDS], rotSin[MAX_ARC_CHORDS];
+  double c = 1.0, s = 0.0;
+  for (int k = 0; k < n; ++k) {
+    double next = c * cosStep - s * sinStep;
+    s = c * sinStep + s * cosStep;
+    c = next;
+    rotCos[k] = c;
+    rotSin[k] = s;
+  }
+
+  double ux = arc.r * std::cos(arc.start), uy = arc.r * std::sin(arc.start);
+  size_t first = out.size();
+  out.resize(first + 2 * size_t(n));
+  double *dst = out.data() + first;
+  for (int k = 0; k < n; ++k) {
+    dst[2 * k] = arc.cx + ux * rotCos[k] - uy * rotSin[k];
+    dst[2 * k + 1] = arc.cy + ux * rotSin[k] + uy * rotCos[k];
+  }
+  dst[2 * n - 2] = x1; // no drift at the joint with the next command
+  dst[2 * n - 1] = y1;
+  return size_t(n);
+}
+
+static Bounds inkBounds(const CommandStream &commands) {
+  Bounds bounds;
+  ArrayView<CommandType> ops = commands.opcodes();
+  ArrayView<float> points = commands.points();
+  ArrayView<float> controls = commands.controls();
+
+  double penX = 0.0, penY = 0.0; // glyphs start at their origin
+  size_t control = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    double x = points[2 * i], y = points[2 * i + 1];
+    if (ops[i] == CommandType::LineTo) {
+      bounds.add(penX, penY);
+      bounds.add(x, y);
+    } else if (ops[i] == CommandType::ArcTo) {
+      addArcBounds(bounds, penX, penY, controls[2 * control],
+                   controls[2 * control + 1], x, y);
+      ++control;
     }
+    penX = x;
+    penY = y;
   }
+  return bounds;
 }
 
-void ShxFont::Impl::compileGlyph(const std::vector<uint8_t> &sourceData,
-                                 std::vector<DrawCommand> &targetCommands,
+Glyph *ShxFont::Impl::compiled(Glyph *glyph) const {
+  if (glyph) {
+    std::call_once(glyphs.compileFlag(*glyph),
+                   [this, glyph]() { compileCommands(*glyph); });
+  }
+  return glyph;
+}
+
+void ShxFont::Impl::compileCommands(Glyph &glyph) const {
+  if (glyph.rawData.empty())
+    return;
+
+  // Initialize parsing state for this glyph
+  std::stack<Point2D> posStack;
+  bool penDown = true;
+  double scale = 1.0;
+  double x = 0.0, y = 0.0;
+
+  // Sub-shapes are read from their raw data only, so compiling one glyph
+  // never waits on another glyph's compilation
+  glyph.commands.clear();
+  compileGlyph(glyph.rawData, glyph.commands, posStack, penDown, scale, x, y,
+               0);
+
+  glyph.commands.shrink_to_fit();
+  glyph.inkBounds = inkBounds(glyph.commands);
+
+  // Calculate width/height after compilation
+  if (!glyph.commands.empty()) {
+    ArrayView<float> points = glyph.commands.points();
+    float minX = 0, maxX = 0, minY = 0, maxY = 0;
+    for (size_t i = 0; i < points.size(); i += 2) {
+      minX = std::min(minX, points[i]);
+      maxX = std::max(maxX, points[i]);
+      minY = std::min(minY, points[i + 1]);
+      maxY = std::max(maxY, points[i + 1]);
+    }
+    glyph.width = maxX - minX;
+    glyph.height = maxY - minY;
+  }
+}
+
+void ShxFont::Impl::precompile() const {
+  for (Glyph &glyph : glyphs) {
+    compiled(&glyph);
+  }
+}
+
+void ShxFont::Impl::appendArc(CommandStream &target, bool penDown, double sx,
+                              double sy, double mx, double my, double ex,
+                              double ey) const {
+  if (!penDown) {
+    target.push_back(DrawCommand::moveTo(ex, ey));
+  } else if (compileTolerance > 0) {
+    std::vector<double> chord;
+    flattenArc(sx, sy, mx, my, ex, ey, compileTolerance, chord);
+    for (size_t i = 0; i < chord.size(); i += 2) {
+      target.push_back(DrawCommand::lineTo(chord[i], chord[i + 1]));
+    }
+  } else {
+    target.push_back(DrawCommand::arcTo(ex, ey, mx, my));
+  }
+}
+
+void ShxFont::Impl::appendCircularArc(CommandStream &target, bool penDown,
+                                      double cx, double cy, double r,
+                                      double ux, double uy, double span,
+                                      double &x, double &y,
+                                      const Point2D *exactEnd) const {
+  // Split into segments of at most 45 degrees; the unit vector (ux, uy) is
+  // rotated by the segment angle instead of evaluating cos/sin per point
+  int steps = static_cast<int>(std::ceil(std::abs(span) / (M_PI / 4.0)));
+  if (steps < 1)
+    steps = 1;
+  double step = span / steps;
+  double cosStep = std::cos(step), sinStep = std::sin(step);
+  double cosHalf = std::cos(step / 2), sinHalf = std::sin(step / 2);
+
+  for (int i = 0; i < steps; ++i) {
+    double midX = ux * cosHalf - uy * sinHalf;
+    double midY = ux * sinHalf + uy * cosHalf;
+    double nextX = ux * cosStep - uy * sinStep;
+    double nextY = ux * sinStep + uy * cosStep;
+
+    double segEndX = cx + r * nextX;
+    double segEndY = cy + r * nextY;
+    if (exactEnd && i == steps - 1) {
+      segEndX = exactEnd->x;
+      segEndY = exactEnd->y;
+    }
+    appendArc(target, penDown, x, y, cx + r * midX, cy + r * midY, segEndX,
+              segEndY);
+    ux = nextX;
+    uy = nextY;
+    x = segEndX;
+    y = segEndY;
+  }
+}
+
+void ShxFont::Impl::appendBulge(CommandStream &target, bool penDown, int dx,
+                                int dy, int bulgeInt, double scale, double &x,
+                                double &y) const {
+  double endX = x + dx * scale;
+  double endY = y + dy * scale;
+  double rawLen = std::sqrt(double(dx) * dx + double(dy) * dy);
+
+  if (bulgeInt == 0 || rawLen < 1e-9) {
+    // Straight segment, or a degenerate chord treated as point/line
+    if (penDown) {
+      target.push_back(DrawCommand::lineTo(endX, endY));
+    } else {
+      target.push_back(DrawCommand::moveTo(endX, endY));
+    }
+  } else {
+    // Robust Bulge -> Center/Radius Conversion
+    double b = bulgeInt / 127.0;
+    double halfChord = (rawLen * scale) / 2.0;
+    // Distance from chord midpoint to center
+    // c = (L/2) * (1/b - b)
+    double cDist = halfChord * (1.0 / b - b);
+
+    // Normal vector (-dy, dx) normalized
+    double cx = (x + endX) / 2.0 - dy / rawLen * cDist;
+    double cy = (y + endY) / 2.0 + dx / rawLen * cDist;
+    double radius = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+
+    // Unit vectors to start and end; their angle is the span
+    double ux = (x - cx) / radius, uy = (y - cy) / radius;
+    double vx = (endX - cx) / radius, vy = (endY - cy) / radius;
+    double span = std::atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+    if (b > 0) { // CCW
+      if (span <= -1e-9)
+        span += 2 * M_PI;
+    } else { // CW
+      if (span >= 1e-9)
+        span -= 2 * M_PI;
+    }
+
+    // Force the final point to match the exact end point
+    Point2D end(endX, endY);
+    appendCircularArc(target, penDown, cx, cy, radius, ux, uy, span, x, y,
+                      &end);
+  }
+
+  x = endX;
+  y = endY;
+}
+
+void ShxFont::Impl::compileGlyph(ByteSpan sourceData,
+                                 CommandStream &targetCommands,
                                  std::stack<Point2D> &posStack, bool &penDown,
-                                 double scale, double x, double y, int depth) {
+                                 double scale, double x, double y,
+                                 int depth) const {
   if (depth > 20)
     return; // Recursion guard
 
@@ -660,9 +1287,8 @@ void ShxFont::Impl::compileGlyph(const std::vector<uint8_t> &sourceData,
           }
         }
 
-        auto it = glyphs.find(subShapeId);
-        if (it != glyphs.end()) {
-          compileGlyph(it->second.rawData, targetCommands, posStack, penDown,
+        if (const Glyph *subShape = glyphs.find(subShapeId)) {
+          compileGlyph(subShape->rawData, targetCommands, posStack, penDown,
                        scale, x, y, depth + 1);
           targetCommands.push_back(DrawCommand::moveTo(x, y));
         }
@@ -725,37 +1351,26 @@ void ShxFont::Impl::compileGlyph(const std::vector<uint8_t> &sourceData,
 
           double r = radius * scale;
 
+          // Every end point and control point lies on a multiple of 22.5
+          // degrees, so the whole arc comes from the half-octant table.
           // Split into single octant segments (45 degrees max) to ensure
           // stability
-          int steps = spanOct;
-          double stepAngle = M_PI / 4.0;
-          if (!ccw)
-            stepAngle = -stepAngle;
-
-          double currentTheta = startOct * (M_PI / 4.0);
+          int half = startOct * 2;
+          int step = ccw ? 1 : -1;
 
           // Center is calculated relative to current pen at start of arc
-          double cx = x - r * cos(currentTheta);
-          double cy = y - r * sin(currentTheta);
-
-          for (int i = 0; i < steps; ++i) {
-            double nextTheta = currentTheta + stepAngle;
-
-            double segEndX = cx + r * cos(nextTheta);
-            double segEndY = cy + r * sin(nextTheta);
-
-            double midTheta = (currentTheta + nextTheta) / 2.0;
-            double ctrlX = cx + r * cos(midTheta);
-            double ctrlY = cy + r * sin(midTheta);
-
-            if (penDown) {
-              targetCommands.push_back(
-                  DrawCommand::arcTo(segEndX, segEndY, ctrlX, ctrlY));
-            } else {
-              targetCommands.push_back(DrawCommand::moveTo(segEndX, segEndY));
-            }
-
-            currentTheta = nextTheta;
+          double cx = x - r * HALF_OCTANT[half][0];
+          double cy = y - r * HALF_OCTANT[half][1];
+
+          for (int i = 0; i < spanOct; ++i) {
+            const double *mid = HALF_OCTANT[(half + step) & 15];
+            half = (half + 2 * step) & 15;
+            const double *end = HALF_OCTANT[half];
+
+            double segEndX = cx + r * end[0];
+            double segEndY = cy + r * end[1];
+            appendArc(targetCommands, penDown, x, y, cx + r * mid[0],
+                      cy + r * mid[1], segEndX, segEndY);
             x = segEndX;
             y = segEndY;
           }
@@ -780,65 +1395,20 @@ void ShxFont::Impl::compileGlyph(const std::vector<uint8_t> &sourceData,
 
           double r = (highRadius * 256.0 + radius) * scale;
 
-          double startFrac = (startOffset / 256.0) * (M_PI / 4.0);
-          double endFrac = (endOffset / 256.0) * (M_PI / 4.0);
-
-          double startAngleGlobal = startOct * (M_PI / 4.0) + startFrac;
-          double endAngleGlobal = (startOct + spanOct) * (M_PI / 4.0) + endFrac;
-
-          // Correct end angle wrapping/span logic for Fractional
-          // Simplistic approach: calculate total span angle
-          double rawStart = startOct * 45.0 + (startOffset / 256.0) * 45.0;
-          double rawEnd =
-              (startOct + spanOct) * 45.0 + (endOffset / 256.0) * 45.0;
-
-          // Adjust rawEnd if it looks wrong?
-          // Actually, standard SHX logic:
-          // Start is StartOct + Offset.
-          // End is StartOct + SpanOct + Offset.
-          // So Span is just SpanOct*45 + (EndOff - StartOff).
-
-          double totalSpanDeg =
-              spanOct * 45.0 + (endOffset - startOffset) * (45.0 / 256.0);
+          // Start is StartOct + Offset, end is StartOct + SpanOct + Offset,
+          // so the span is SpanOct*45 + (EndOff - StartOff)
+          double startAngle =
+              (startOct + startOffset / 256.0) * (M_PI / 4.0);
+          double span =
+              (spanOct + (endOffset - startOffset) / 256.0) * (M_PI / 4.0);
           if (!ccw)
-            totalSpanDeg = -totalSpanDeg;
+            span = -span;
 
-          double totalSpanRad = totalSpanDeg * M_PI / 180.0;
-
-          // Center calc
-          double cx = x - r * cos(startAngleGlobal);
-          double cy = y - r * sin(startAngleGlobal);
-
-          // Split if large. Let's split every 45 degrees (approx)
-          int steps =
-              static_cast<int>(std::ceil(std::abs(totalSpanDeg) / 45.0));
-          if (steps < 1)
-            steps = 1;
-
-          double stepRad = totalSpanRad / steps;
-          double currentTheta = startAngleGlobal;
-
-          for (int i = 0; i < steps; ++i) {
-            double nextTheta = currentTheta + stepRad;
-
-            double segEndX = cx + r * cos(nextTheta);
-            double segEndY = cy + r * sin(nextTheta);
-
-            double midTheta = (currentTheta + nextTheta) / 2.0;
-            double ctrlX = cx + r * cos(midTheta);
-            double ctrlY = cy + r * sin(midTheta);
-
-            if (penDown) {
-              targetCommands.push_back(
-                  DrawCommand::arcTo(segEndX, segEndY, ctrlX, ctrlY));
-            } else {
-              targetCommands.push_back(DrawCommand::moveTo(segEndX, segEndY));
-            }
-
-            currentTheta = nextTheta;
-            x = segEndX;
-            y = segEndY;
-          }
+          double ux = std::cos(startAngle), uy = std::sin(startAngle);
+          double cx = x - r * ux;
+          double cy = y - r * uy;
+          appendCircularArc(targetCommands, penDown, cx, cy, r, ux, uy, span,
+                            x, y);
         }
         break;
       }
@@ -849,102 +1419,7 @@ void ShxFont::Impl::compileGlyph(const std::vector<uint8_t> &sourceData,
           int8_t dy = static_cast<int8_t>(sourceData[pos++]);
           int8_t bulgeInt = static_cast<int8_t>(sourceData[pos++]);
 
-          double endX = x + dx * scale;
-          double endY = y + dy * scale;
-
-          if (bulgeInt == 0) {
-            if (penDown) {
-              targetCommands.push_back(DrawCommand::lineTo(endX, endY));
-            } else {
-              targetCommands.push_back(DrawCommand::moveTo(endX, endY));
-            }
-          } else {
-            // Robust Bulge -> Center/Radius Conversion
-            double b = bulgeInt / 127.0;
-            double rawLen = sqrt(double(dx) * dx + double(dy) * dy);
-
-            if (rawLen < 1e-9) {
-              // Degenerate chord, treat as point/line
-              if (penDown)
-                targetCommands.push_back(DrawCommand::lineTo(endX, endY));
-              else
-                targetCommands.push_back(DrawCommand::moveTo(endX, endY));
-            } else {
-              double halfChord = (rawLen * scale) / 2.0;
-              // Distance from chord midpoint to center
-              // c = (L/2) * (1/b - b)
-              double c_dist = halfChord * (1.0 / b - b);
-
-              double midX = (x + endX) / 2.0;
-              double midY = (y + endY) / 2.0;
-
-              // Normal vector (-dy, dx) normalized
-              double nx = -dy / rawLen;
-              double ny = dx / rawLen;
-
-              double cx = midX + nx * c_dist;
-              double cy = midY + ny * c_dist;
-
-              double radius = sqrt(pow(x - cx, 2) + pow(y - cy, 2));
-
-              double startAngle = atan2(y - cy, x - cx);
-              double endAngle = atan2(endY - cy, endX - cx);
-
-              // Handle angle wrapping
-              double span = endAngle - startAngle;
-              if (b > 0) { // CCW
-                if (span <= -1e-9)
-                  span += 2 * M_PI;
-              } else { // CW
-                if (span >= 1e-9)
-                  span -= 2 * M_PI;
-              }
-
-              // Split into segments (max 45 deg)
-              int steps =
-                  static_cast<int>(std::ceil(std::abs(span) / (M_PI / 4.0)));
-              if (steps < 1)
-                steps = 1;
-              double stepAngle = span / steps;
-
-              double currentTheta = startAngle;
-              double currentX = x; // Start from exact current pos to avoid gaps
-              double currentY = y;
-
-              for (int i = 0; i < steps; ++i) {
-                double nextTheta = currentTheta + stepAngle;
-
-                // Calculate target to effectively normalize radius precision
-                double segEndX = cx + radius * cos(nextTheta);
-                double segEndY = cy + radius * sin(nextTheta);
-
-                // Force final point to match exact end point on last step
-                if (i == steps - 1) {
-                  segEndX = endX;
-                  segEndY = endY;
-                }
-
-                double midTheta = (currentTheta + nextTheta) / 2.0;
-                double ctrlX = cx + radius * cos(midTheta);
-                double ctrlY = cy + radius * sin(midTheta);
-
-                if (penDown) {
-                  targetCommands.push_back(
-                      DrawCommand::arcTo(segEndX, segEndY, ctrlX, ctrlY));
-                } else {
-                  targetCommands.push_back(
-                      DrawCommand::moveTo(segEndX, segEndY));
-                }
-
-                currentTheta = nextTheta;
-                currentX = segEndX;
-                currentY = segEndY;
-              }
-            }
-          }
-
-          x = endX;
-          y = endY;
+          appendBulge(targetCommands, penDown, dx, dy, bulgeInt, scale, x, y);
         }
         break;
       }
@@ -962,91 +1437,7 @@ void ShxFont::Impl::compileGlyph(const std::vector<uint8_t> &sourceData,
             bulgeInt = static_cast<int8_t>(sourceData[pos++]);
           }
 
-          double endX = x + dx * scale;
-          double endY = y + dy * scale;
-
-          if (bulgeInt == 0) {
-            if (penDown) {
-              targetCommands.push_back(DrawCommand::lineTo(endX, endY));
-            } else {
-              targetCommands.push_back(DrawCommand::moveTo(endX, endY));
-            }
-          } else {
-            // Robust Bulge -> Center/Radius Conversion
-            double b = bulgeInt / 127.0;
-            double rawLen = sqrt(double(dx) * dx + double(dy) * dy);
-
-            if (rawLen < 1e-9) {
-              if (penDown)
-                targetCommands.push_back(DrawCommand::lineTo(endX, endY));
-              else
-                targetCommands.push_back(DrawCommand::moveTo(endX, endY));
-            } else {
-              double halfChord = (rawLen * scale) / 2.0;
-              // Distance from chord midpoint to center
-              double c_dist = halfChord * (1.0 / b - b);
-
-              double midX = (x + endX) / 2.0;
-              double midY = (y + endY) / 2.0;
-
-              double nx = -dy / rawLen;
-              double ny = dx / rawLen;
-
-              double cx = midX + nx * c_dist;
-              double cy = midY + ny * c_dist;
-
-              double radius = sqrt(pow(x - cx, 2) + pow(y - cy, 2));
-
-              double startAngle = atan2(y - cy, x - cx);
-              double endAngle = atan2(endY - cy, endX - cx);
-
-              double span = endAngle - startAngle;
-              if (b > 0) { // CCW
-                if (span <= -1e-9)
-                  span += 2 * M_PI;
-              } else { // CW
-                if (span >= 1e-9)
-                  span -= 2 * M_PI;
-              }
-
-              int steps =
-                  static_cast<int>(std::ceil(std::abs(span) / (M_PI / 4.0)));
-              if (steps < 1)
-                steps = 1;
-              double stepAngle = span / steps;
-
-              double currentTheta = startAngle;
-
-              for (int i = 0; i < steps; ++i) {
-                double nextTheta = currentTheta + stepAngle;
-
-                double segEndX = cx + radius * cos(nextTheta);
-                double segEndY = cy + radius * sin(nextTheta);
-
-                if (i == steps - 1) {
-                  segEndX = endX;
-                  segEndY = endY;
-                }
-
-                double midTheta = (currentTheta + nextTheta) / 2.0;
-                double ctrlX = cx + radius * cos(midTheta);
-                double ctrlY = cy + radius * sin(midTheta);
-
-                if (penDown) {
-                  targetCommands.push_back(
-                      DrawCommand::arcTo(segEndX, segEndY, ctrlX, ctrlY));
-                } else {
-                  targetCommands.push_back(
-                      DrawCommand::moveTo(segEndX, segEndY));
-                }
-
-                currentTheta = nextTheta;
-              }
-            }
-          }
-
-          x = endX;
-          y = endY;
+          appendBulge(targetCommands, penDown, dx, dy, bulgeInt, scale, x, y);
         }
         break;
       }
@@ -1083,40 +1474,66 @@ void ShxFont::Impl::compileGlyph(const std::vector<uint8_t> &sourceData,
 }
 
 const Glyph *ShxFont::Impl::getGlyph(uint32_t code) const {
-  auto it = glyphs.find(code);
-  if (it != glyphs.end()) {
-    return &it->second;
-  }
-  return nullptr;
+  return compiled(glyphs.find(code));
 }
 
 bool ShxFont::Impl::hasGlyph(uint32_t code) const {
-  return glyphs.find(code) != glyphs.end();
+  return glyphs.find(code) != nullptr;
+}
+
+uint32_t ShxFont::Impl::mapCodePoint(uint32_t codePoint) const {
+  if (fontType != ShxFontType::BigFont || codePoint < 0x80)
+    return codePoint;
+  uint32_t code = unicodeToGbk(codePoint);
+  // A font without ranges takes every GBK double-byte code
+  if (code != 0 && doubleByteRanges.empty())
+    return code;
+  return leadBytes.test(code >> 8) ? code : 0;
+}
+
+const Glyph *ShxFont::Impl::glyphForCodePoint(uint32_t codePoint) const {
+  uint32_t code = mapCodePoint(codePoint);
+  return code ? getGlyph(code) : nullptr;
 }
 
 void ShxFont::Impl::renderGlyph(IPathRenderer &renderer, const Glyph *glyph,
-                                double scale, double originX,
-                                double originY) const {
+                                double scale, double originX, double originY,
+                                std::vector<double> &scratch) const {
   if (!glyph)
     return;
 
-  for (const auto &cmd : glyph->commands) {
-    double px = originX + cmd.endPoint.x * scale;
-    double py = originY + cmd.endPoint.y * scale;
+  const CommandStream &commands = glyph->commands;
+  ArrayView<float> points = commands.points();
+  ArrayView<float> controls = commands.controls();
+
+  // Transform both coordinate streams in straight loops first, then replay
+  // the opcodes against the transformed coordinates
+  const size_t pointCount = points.size();
+  scratch.resize(pointCount + controls.size());
+  double *xy = scratch.data();
+  double *ctrl = xy + pointCount;
+  for (size_t i = 0; i < pointCount; i += 2) {
+    xy[i] = originX + points[i] * scale;
+    xy[i + 1] = originY + points[i + 1] * scale;
+  }
+  for (size_t i = 0; i < controls.size(); i += 2) {
+    ctrl[i] = originX + controls[i] * scale;
+    ctrl[i + 1] = originY + controls[i + 1] * scale;
+  }
 
-    switch (cmd.type) {
+  ArrayView<CommandType> ops = commands.opcodes();
+  for (size_t i = 0; i < ops.size(); ++i, xy += 2) {
+    switch (ops[i]) {
     case CommandType::MoveTo:
-      renderer.moveTo(px, py);
+      renderer.moveTo(xy[0], xy[1]);
       break;
     case CommandType::LineTo:
-      renderer.lineTo(px, py);
+      renderer.lineTo(xy[0], xy[1]);
       break;
-    case CommandType::ArcTo: {
-      double cx = originX + cmd.controlPoint.x * scale;
-      double cy = originY + cmd.controlPoint.y * scale;
-      renderer.arcTo(px, py, cx, cy);
+    case CommandType::ArcTo:
+      renderer.arcTo(xy[0], xy[1], ctrl[0], ctrl[1]);
+      ctrl += 2;
       break;
-    }
     // SubShapes are now inlined, so no need to handle CommandType::SubShape
     default:
       break;
@@ -1134,12 +1551,12 @@ void ShxFont::Impl::render(IPathRenderer &renderer, const std::string &text,
   double x = startX;
   double y = startY;
 
-  auto codePoints = utf8ToCodePoints(text);
+  std::vector<double> scratch;
 
-  for (uint32_t code : codePoints) {
-    const Glyph *glyph = getGlyph(code);
+  for (size_t pos = 0; pos < text.size();) {
+    const Glyph *glyph = glyphForCodePoint(nextCodePoint(text, pos));
     if (glyph) {
-      renderGlyph(renderer, glyph, scale, x, y);
+      renderGlyph(renderer, glyph, scale, x, y, scratch);
       x += glyph->width * scale;
     } else {
       x += defWidth * scale;
@@ -1155,10 +1572,8 @@ double ShxFont::Impl::measureText(const std::string &text,
   double scale = (baseHeight > 0) ? (fontSize / baseHeight) : fontSize;
   double width = 0.0;
 
-  auto codePoints = utf8ToCodePoints(text);
-
-  for (uint32_t code : codePoints) {
-    const Glyph *glyph = getGlyph(code);
+  for (size_t pos = 0; pos < text.size();) {
+    const Glyph *glyph = glyphForCodePoint(nextCodePoint(text, pos));
     if (glyph) {
       width += glyph->width * scale;
     } else {
@@ -1169,6 +1584,484 @@ double ShxFont::Impl::measureText(const std::string &text,
   return width;
 }
 
+void ShxFont::Impl::layoutBatch(const TextRecord *records, size_t count,
+                                TextMesh &mesh,
+                                const LayoutOptions &options) const {
+  const int arcSegments = std::max(1, options.arcSegments);
+
+  for (const TextRecord &record : ArrayView<TextRecord>(records, count)) {
+    TextMesh::Range range;
+    range.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+
+    // Font units -> world: stretch, rotate, translate in one affine map
+    double scale =
+        (baseHeight > 0) ? (record.height / baseHeight) : record.height;
+    double radians = record.angle * M_PI / 180.0;
+    double cosA = std::cos(radians), sinA = std::sin(radians);
+    double m00 = scale * record.widthFactor * cosA, m01 = -scale * sinA;
+    double m10 = scale * record.widthFactor * sinA, m11 = scale * cosA;
+
+    std::vector<double> &vertices = mesh.vertices;
+    std::vector<uint32_t> &indices = mesh.indices;
+    auto emit = [&](double u, double v) {
+      vertices.push_back(record.x + m00 * u + m01 * v);
+      vertices.push_back(record.y + m10 * u + m11 * v);
+      return static_cast<uint32_t>(vertices.size() / 2 - 1);
+    };
+
+    double cursor = 0.0; // Pen advance in font units
+    const std::string &text = record.text;
+    for (size_t pos = 0; pos < text.size();) {
+      const Glyph *glyph = glyphForCodePoint(nextCodePoint(text, pos));
+      if (!glyph) {
+        cursor += defWidth;
+        continue;
+      }
+
+      const CommandStream &commands = glyph->commands;
+      const CommandType *ops = commands.opcodes().data();
+      const float *points = commands.points().data();
+      const float *controls = commands.controls().data();
+      const size_t count = commands.size();
+
+      // The current pen position is only emitted once a stroke starts
+      double penU = cursor, penV = 0.0;
+      bool penEmitted = false;
+      uint32_t penIndex = 0;
+
+      for (size_t i = 0; i < count; ++i, points += 2) {
+        double u = cursor + points[0], v = points[1];
+        switch (ops[i]) {
+        case CommandType::LineTo:
+          if (!penEmitted)
+            penIndex = emit(penU, penV);
+          indices.push_back(penIndex);
+          penIndex = emit(u, v);
+          indices.push_back(penIndex);
+          penEmitted = true;
+          break;
+        case CommandType::ArcTo: {
+          if (!penEmitted)
+            penIndex = emit(penU, penV);
+          // Quadratic through start, on-arc midpoint and end; each compiled
+          // arc spans at most 45 degrees, so the deviation is negligible
+          double mu = cursor + controls[0], mv = controls[1];
+          controls += 2;
+          for (int k = 1; k <= arcSegments; ++k) {
+            double t = double(k) / arcSegments;
+            double w0 = (1 - t) * (1 - 2 * t), w1 = 4 * t * (1 - t),
+                   w2 = t * (2 * t - 1);
+            indices.push_back(penIndex);
+            penIndex = emit(w0 * penU + w1 * mu + w2 * u,
+                            w0 * penV + w1 * mv + w2 * v);
+            indices.push_back(penIndex);
+          }
+          penEmitted = true;
+          break;
+        }
+        default: // MoveTo; sub-shapes are inlined at compile time
+          penEmitted = false;
+          break;
+        }
+        penU = u;
+        penV = v;
+      }
+      cursor += glyph->width;
+    }
+
+    range.indexCount =
+        static_cast<uint32_t>(mesh.indices.size()) - range.firstIndex;
+    range.advance = cursor * scale * record.widthFactor;
+    mesh.ranges.push_back(range);
+  }
+}
+
+// Fewest records worth handing to a thread of their own
+static const size_t MIN_RECORDS_PER_THREAD = 16;
+
+void ShxFont::Impl::layoutParallel(const std::vector<TextRecord> &records,
+                                   TextMesh &mesh, const LayoutOptions &options,
+                                   unsigned threads) const {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t chunks = std::min<size_t>(
+      threads, (records.size() + MIN_RECORDS_PER_THREAD - 1) /
+                   MIN_RECORDS_PER_THREAD);
+  if (chunks <= 1) {
+    layoutBatch(records.data(), records.size(), mesh, options);
+    return;
+  }
+
+  // Each chunk gets its own mesh; this thread lays out the first one
+  std::vector<TextMesh> parts(chunks);
+  std::vector<std::exception_ptr> errors(chunks);
+  size_t perChunk = (records.size() + chunks - 1) / chunks;
+  auto work = [&](size_t chunk) {
+    size_t first = chunk * perChunk;
+    size_t count = std::min(perChunk, records.size() - first);
+    try {
+      layoutBatch(records.data() + first, count, parts[chunk], options);
+    } catch (...) {
+      errors[chunk] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(chunks - 1);
+  for (size_t chunk = 1; chunk < chunks; ++chunk) {
+    workers.emplace_back(work, chunk);
+  }
+  work(0);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  for (const std::exception_ptr &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  // Concatenate in record order, rebasing indices onto the shared buffers
+  for (const TextMesh &part : parts) {
+    uint32_t vertexBase = static_cast<uint32_t>(mesh.vertexCount());
+    uint32_t indexBase = static_cast<uint32_t>(mesh.indices.size());
+    mesh.vertices.insert(mesh.vertices.end(), part.vertices.begin(),
+                         part.vertices.end());
+    for (uint32_t index : part.indices) {
+      mesh.indices.push_back(vertexBase + index);
+    }
+    for (TextMesh::Range range : part.ranges) {
+      range.firstIndex += indexBase;
+      mesh.ranges.push_back(range);
+    }
+  }
+}
+
+//=============================================================================
+// Font Cache
+//=============================================================================
+
+// Precompiled font cache (.shxc), native little-endian layout:
+//   CacheHeader
+//   uint16_t ranges[2 * rangeCount]         BigFont lead-byte ranges
+//   font name (nameLength bytes, padded to 8)
+//   CacheGlyph[glyphCount]                  in code order, with ink bounds
+//   float points[2 * opCount]               end points of all glyphs
+//   float controls[2 * controlCount]        arc control points
+//   CommandType ops[opCount]                (padded to 4)
+//   uint16_t subShapes[subShapeCount]
+// The streams are used in place through borrowed CommandStreams. A cache is
+// valid only for the exact source bytes (size + FNV-1a), format version and
+// arc tolerance.
+
+static const char CACHE_MAGIC[8] = {'S', 'H', 'X', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t CACHE_VERSION = 3;
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t fontType;
+  uint64_t sourceHash;
+  uint64_t sourceSize;
+  double baseHeight;
+  double descender;
+  double defWidth;
+  uint32_t glyphCount;
+  uint32_t opCount;
+  uint32_t controlCount;
+  uint32_t subShapeCount;
+  uint32_t nameLength;
+  float arcTolerance; // 0 when arcs are kept as ArcTo
+  uint32_t rangeCount;
+  uint32_t reserved;
+};
+
+struct CacheGlyph {
+  uint32_t code;
+  uint32_t firstOp;
+  uint32_t opCount;
+  uint32_t firstControl; // in points, not floats
+  uint32_t controlCount;
+  uint32_t firstSubShape;
+  uint32_t subShapeCount;
+  float width;
+  float height;
+  uint32_t hasInk;
+  double inkMinX; // exact, so cached and compiled bounds agree
+  double inkMinY;
+  double inkMaxX;
+  double inkMaxY;
+};
+
+static_assert(sizeof(CacheHeader) == 88, "cache header layout");
+static_assert(sizeof(CacheGlyph) == 72, "cache glyph layout");
+
+static inline size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t fnv1a(const uint8_t *data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool ShxFont::Impl::loadCached(const std::string &filename,
+                               const std::string &cacheFile) {
+  reset();
+  if (!mapping.open(filename)) {
+    return load(filename);
+  }
+
+  uint64_t sourceHash = fnv1a(mapping.data(), mapping.size());
+  uint64_t sourceSize = mapping.size();
+  if (readCache(cacheFile, sourceHash, sourceSize)) {
+    mapping.close(); // source bytes are not needed any more
+    return true;
+  }
+
+  if (!parse(mapping.data(), mapping.size())) {
+    return false;
+  }
+  // Best effort: a read-only font directory just means no cache next time
+  writeCache(cacheFile, sourceHash, sourceSize);
+  return true;
+}
+
+bool ShxFont::Impl::saveCache(const std::string &cacheFile) const {
+  if (!valid) {
+    return false;
+  }
+  if (cacheMapping.data()) {
+    return writeCache(cacheFile, cacheSourceHash, cacheSourceSize);
+  }
+  const uint8_t *source = mapping.data() ? mapping.data() : ownedData.data();
+  size_t sourceSize = mapping.data() ? mapping.size() : ownedData.size();
+  return writeCache(cacheFile, fnv1a(source, sourceSize), sourceSize);
+}
+
+bool ShxFont::Impl::readCache(const std::string &cacheFile,
+                              uint64_t sourceHash, uint64_t sourceSize) {
+  MappedFile file;
+  if (!file.open(cacheFile) || file.size() < sizeof(CacheHeader)) {
+    return false;
+  }
+
+  CacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header.version != CACHE_VERSION || header.sourceHash != sourceHash ||
+      header.sourceSize != sourceSize ||
+      header.arcTolerance != static_cast<float>(compileTolerance)) {
+    return false;
+  }
+
+  // Section offsets; all counts are 32-bit so this cannot overflow size_t
+  size_t nameOffset =
+      sizeof(CacheHeader) + size_t(header.rangeCount) * 2 * sizeof(uint16_t);
+  size_t glyphOffset = alignUp(nameOffset + header.nameLength, 8);
+  size_t pointOffset =
+      glyphOffset + size_t(header.glyphCount) * sizeof(CacheGlyph);
+  size_t controlOffset =
+      pointOffset + size_t(header.opCount) * 2 * sizeof(float);
+  size_t opOffset =
+      controlOffset + size_t(header.controlCount) * 2 * sizeof(float);
+  size_t subShapeOffset = alignUp(opOffset + header.opCount, 4);
+  size_t totalSize =
+      subShapeOffset + size_t(header.subShapeCount) * sizeof(uint16_t);
+  if (file.size() < totalSize) {
+    return false;
+  }
+
+  const uint8_t *base = file.data();
+  const CacheGlyph *records =
+      reinterpret_cast<const CacheGlyph *>(base + glyphOffset);
+  const float *points = reinterpret_cast<const float *>(base + pointOffset);
+  const float *controls =
+      reinterpret_cast<const float *>(base + controlOffset);
+  const CommandType *ops =
+      reinterpret_cast<const CommandType *>(base + opOffset);
+  const uint16_t *subShapes =
+      reinterpret_cast<const uint16_t *>(base + subShapeOffset);
+
+  // Validate every record against its opcodes before trusting the streams
+  for (uint32_t i = 0; i < header.glyphCount; ++i) {
+    const CacheGlyph &record = records[i];
+    if (record.code > 0xFFFF ||
+        uint64_t(record.firstOp) + record.opCount > header.opCount ||
+        uint64_t(record.firstControl) + record.controlCount >
+            header.controlCount ||
+        uint64_t(record.firstSubShape) + record.subShapeCount >
+            header.subShapeCount) {
+      return false;
+    }
+    uint32_t arcs = 0, subs = 0;
+    for (uint32_t j = 0; j < record.opCount; ++j) {
+      CommandType type = ops[record.firstOp + j];
+      if (type > CommandType::SubShape)
+        return false;
+      arcs += (type == CommandType::ArcTo);
+      subs += (type == CommandType::SubShape);
+    }
+    if (arcs != record.controlCount || subs != record.subShapeCount)
+      return false;
+  }
+
+  fontType = static_cast<ShxFontType>(header.fontType);
+  fontName.assign(reinterpret_cast<const char *>(base + nameOffset),
+                  header.nameLength);
+  std::vector<std::pair<uint16_t, uint16_t>> ranges(header.rangeCount);
+  for (uint32_t i = 0; i < header.rangeCount; ++i) {
+    std::memcpy(&ranges[i].first, base + sizeof(CacheHeader) + 4 * i, 2);
+    std::memcpy(&ranges[i].second, base + sizeof(CacheHeader) + 4 * i + 2, 2);
+  }
+  setDoubleByteRanges(std::move(ranges));
+  baseHeight = header.baseHeight;
+  descender = header.descender;
+  defWidth = header.defWidth;
+
+  for (uint32_t i = 0; i < header.glyphCount; ++i) {
+    const CacheGlyph &record = records[i];
+    Glyph glyph;
+    glyph.code = record.code;
+    glyph.width = record.width;
+    glyph.height = record.height;
+    if (record.hasInk) {
+      glyph.inkBounds.add(record.inkMinX, record.inkMinY);
+      glyph.inkBounds.add(record.inkMaxX, record.inkMaxY);
+    }
+    glyph.commands = CommandStream::borrow(
+        ArrayView<CommandType>(ops + record.firstOp, record.opCount),
+        ArrayView<float>(points + 2 * size_t(record.firstOp),
+                         2 * size_t(record.opCount)),
+        ArrayView<float>(controls + 2 * size_t(record.firstControl),
+                         2 * size_t(record.controlCount)),
+        ArrayView<uint16_t>(subShapes + record.firstSubShape,
+                            record.subShapeCount));
+    glyphs.insert(record.code, std::move(glyph));
+  }
+  glyphs.seal();
+
+  cacheMapping = std::move(file);
+  cacheSourceHash = sourceHash;
+  cacheSourceSize = sourceSize;
+  valid = true;
+  return true;
+}
+
+bool ShxFont::Impl::writeCache(const std::string &cacheFile,
+                               uint64_t sourceHash,
+                               uint64_t sourceSize) const {
+  precompile();
+
+  CacheHeader header = {};
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.fontType = static_cast<uint32_t>(fontType);
+  header.sourceHash = sourceHash;
+  header.sourceSize = sourceSize;
+  header.baseHeight = baseHeight;
+  header.descender = descender;
+  header.defWidth = defWidth;
+  header.nameLength = static_cast<uint32_t>(fontName.size());
+  header.rangeCount = static_cast<uint32_t>(doubleByteRanges.size());
+  header.arcTolerance = static_cast<float>(compileTolerance);
+
+  std::vector<CacheGlyph> records;
+  std::vector<float> points, controls;
+  std::vector<CommandType> ops;
+  std::vector<uint16_t> subShapes;
+  for (const Glyph &glyph : glyphs) {
+    const CommandStream &commands = glyph.commands;
+    CacheGlyph record = {};
+    record.code = glyph.code;
+    record.firstOp = static_cast<uint32_t>(ops.size());
+    record.opCount = static_cast<uint32_t>(commands.size());
+    record.firstControl = static_cast<uint32_t>(controls.size() / 2);
+    record.controlCount = static_cast<uint32_t>(commands.controls().size() / 2);
+    record.firstSubShape = static_cast<uint32_t>(subShapes.size());
+    record.subShapeCount = static_cast<uint32_t>(commands.subShapes().size());
+    record.width = static_cast<float>(glyph.width);
+    record.height = static_cast<float>(glyph.height);
+    record.hasInk = glyph.inkBounds.valid ? 1 : 0;
+    record.inkMinX = glyph.inkBounds.minX;
+    record.inkMinY = glyph.inkBounds.minY;
+    record.inkMaxX = glyph.inkBounds.maxX;
+    record.inkMaxY = glyph.inkBounds.maxY;
+    records.push_back(record);
+
+    ops.insert(ops.end(), commands.opcodes().begin(), commands.opcodes().end());
+    points.insert(points.end(), commands.points().begin(),
+                  commands.points().end());
+    controls.insert(controls.end(), commands.controls().begin(),
+                    commands.controls().end());
+    subShapes.insert(subShapes.end(), commands.subShapes().begin(),
+                     commands.subShapes().end());
+  }
+  std::sort(records.begin(), records.end(),
+            [](const CacheGlyph &a, const CacheGlyph &b) {
+              return a.code < b.code;
+            });
+  header.glyphCount = static_cast<uint32_t>(records.size());
+  header.opCount = static_cast<uint32_t>(ops.size());
+  header.controlCount = static_cast<uint32_t>(controls.size() / 2);
+  header.subShapeCount = static_cast<uint32_t>(subShapes.size());
+
+  // Write to a temporary file and rename, so readers never map a torn cache.
+  // The temp name is unique per process and thread: two writers building the
+  // same cache must not interleave into one file
+#ifdef _WIN32
+  const unsigned long pid = GetCurrentProcessId();
+#else
+  const unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+  std::string tempFile =
+      cacheFile + "." + std::to_string(pid) + "." +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+      ".tmp";
+  {
+    std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      return false;
+    }
+    const char padding[8] = {};
+    auto write = [&out](const void *data, size_t size) {
+      out.write(static_cast<const char *>(data),
+                static_cast<std::streamsize>(size));
+    };
+    write(&header, sizeof(header));
+    for (const auto &range : doubleByteRanges) {
+      write(&range.first, sizeof(uint16_t));
+      write(&range.second, sizeof(uint16_t));
+    }
+    size_t nameEnd = sizeof(header) +
+                     doubleByteRanges.size() * 2 * sizeof(uint16_t) +
+                     fontName.size();
+    write(fontName.data(), fontName.size());
+    write(padding, alignUp(nameEnd, 8) - nameEnd);
+    write(records.data(), records.size() * sizeof(CacheGlyph));
+    write(points.data(), points.size() * sizeof(float));
+    write(controls.data(), controls.size() * sizeof(float));
+    write(ops.data(), ops.size());
+    write(padding, alignUp(ops.size(), 4) - ops.size());
+    write(subShapes.data(), subShapes.size() * sizeof(uint16_t));
+    if (!out) {
+      out.close();
+      std::remove(tempFile.c_str());
+      return false;
+    }
+  }
+
+  std::remove(cacheFile.c_str());
+  if (std::rename(tempFile.c_str(), cacheFile.c_str()) != 0) {
+    std::remove(tempFile.c_str());
+    return false;
+  }
+  return true;
+}
+
 //=============================================================================
 // ShxFont Public Interface
 //=============================================================================
@@ -1188,12 +2081,25 @@ bool ShxFont::loadFromMemory(const uint8_t *data, size_t size) {
   return pImpl->loadFromMemory(data, size);
 }
 
+bool ShxFont::loadCached(const std::string &filename,
+                         const std::string &cacheFile) {
+  return pImpl->loadCached(filename, cacheFile);
+}
+
+bool ShxFont::saveCache(const std::string &cacheFile) const {
+  return pImpl->saveCache(cacheFile);
+}
+
 const Glyph *ShxFont::getGlyph(uint32_t code) const {
   return pImpl->getGlyph(code);
 }
 
 bool ShxFont::hasGlyph(uint32_t code) const { return pImpl->hasGlyph(code); }
 
+uint32_t ShxFont::mapCodePoint(uint32_t codePoint) const {
+  return pImpl->mapCodePoint(codePoint);
+}
+
 const Glyph *ShxFont::getGlyphByShape(uint16_t shapeId) const {
   return pImpl->getGlyph(static_cast<uint32_t>(shapeId));
 }
@@ -1207,6 +2113,25 @@ double ShxFont::measureText(const std::string &text, double fontSize) const {
   return pImpl->measureText(text, fontSize);
 }
 
+void ShxFont::precompile() const { pImpl->precompile(); }
+
+void ShxFont::setArcTolerance(double tolerance) {
+  pImpl->arcTolerance = tolerance > 0 ? tolerance : 0.0;
+}
+
+double ShxFont::getArcTolerance() const { return pImpl->arcTolerance; }
+
+void ShxFont::layoutBatch(const std::vector<TextRecord> &records,
+                          TextMesh &mesh, const LayoutOptions &options) const {
+  pImpl->layoutBatch(records.data(), records.size(), mesh, options);
+}
+
+void ShxFont::layoutParallel(const std::vector<TextRecord> &records,
+                             TextMesh &mesh, const LayoutOptions &options,
+                             unsigned threads) const {
+  pImpl->layoutParallel(records, mesh, options, threads);
+}
+
 ShxFontType ShxFont::getFontType() const { return pImpl->fontType; }
 
 const std::string &ShxFont::getFontName() const { return pImpl->fontName; }
@@ -1217,6 +2142,11 @@ double ShxFont::getDescender() const { return pImpl->descender; }
 
 size_t ShxFont::getGlyphCount() const { return pImpl->glyphs.size(); }
 
+const std::vector<std::pair<uint16_t, uint16_t>> &
+ShxFont::getDoubleByteRanges() const {
+  return pImpl->doubleByteRanges;
+}
+
 const std::string &ShxFont::getLastError() const { return pImpl->lastError; }
 
 bool ShxFont::isValid() const { return pImpl->valid; }
@@ -1227,6 +2157,53 @@ bool ShxFont::isValid() const { return pImpl->valid; }
 
 const char *getVersion() { return SHX_VERSION; }
 
+std::string defaultCachePath(const std::string &filename) {
+  size_t slash = filename.find_last_of("/\\");
+  size_t dot = filename.find_last_of('.');
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash)) {
+    return filename + ".shxc";
+  }
+  return filename.substr(0, dot) + ".shxc";
+}
+
+uint32_t nextCodePoint(const std::string &text, size_t &pos) {
+  const uint32_t replacement = 0xFFFD;
+  uint8_t lead = static_cast<uint8_t>(text[pos++]);
+  if (lead < 0x80)
+    return lead;
+
+  int extra;
+  uint32_t cp;
+  if ((lead & 0xE0) == 0xC0) {
+    extra = 1;
+    cp = lead & 0x1F;
+  } else if ((lead & 0xF0) == 0xE0) {
+    extra = 2;
+    cp = lead & 0x0F;
+  } else if ((lead & 0xF8) == 0xF0) {
+    extra = 3;
+    cp = lead & 0x07;
+  } else {
+    return replacement; // stray continuation byte or invalid lead
+  }
+
+  for (; extra > 0; --extra) {
+    if (pos >= text.size() || (text[pos] & 0xC0) != 0x80)
+      return replacement;
+    cp = (cp << 6) | (static_cast<uint8_t>(text[pos++]) & 0x3F);
+  }
+  return cp;
+}
+
+uint32_t unicodeToGbk(uint32_t codePoint) {
+  if (codePoint < 0x80)
+    return codePoint;
+  if (codePoint > 0xFFFF)
+    return 0;
+  return GBK_PAGES[GBK_PAGE_INDEX[codePoint >> 8]][codePoint & 0xFF];
+}
+
 bool isValidShxFile(const std::string &filename) {
   std::ifstream file(filename, std::ios::binary);
   if (!file.is_open()) {
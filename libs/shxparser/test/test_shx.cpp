@@ -6,7 +6,12 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 // Simple test framework
 #define TEST(name) void test_##name()
@@ -123,6 +128,388 @@ TEST(shx_font_move) {
     ASSERT_FALSE(font2.isValid());
 }
 
+// Minimal in-memory unifont: glyphs spread over several pages of the code
+// space, one of them drawing another as a sub-shape
+static std::vector<uint8_t> makeUniFont() {
+    std::vector<uint8_t> data;
+    const std::string header = "AutoCAD-86 unifont 1.0\r\n\x1A";
+    data.insert(data.end(), header.begin(), header.end());
+
+    auto u16 = [&](uint16_t v) {
+        data.push_back(v & 0xFF);
+        data.push_back(v >> 8);
+    };
+    auto glyph = [&](uint16_t code, std::vector<uint8_t> bytes) {
+        u16(code);
+        u16(static_cast<uint16_t>(bytes.size()));
+        data.insert(data.end(), bytes.begin(), bytes.end());
+    };
+
+    u16(6); u16(0);          // count (u32), description length
+    u16(0);
+    glyph(0x0041, {0x14, 0x00});                  // 1 unit north
+    glyph(0x4E2D, {0x10, 0x00});                  // 1 unit east
+    glyph(0x4E2E, {0x07, 0x41, 0x00, 0x10, 0x00}); // 'A' then 1 unit east
+    glyph(0xFFFF, {0x18, 0x00});                  // 1 unit west
+    glyph(0x0100, {0x0C, 0x03, 0x01, 0x7F, 0x00}); // semicircle to (3, 1)
+    glyph(0x4E2D, {0x20, 0x00});                  // redefinition wins
+    return data;
+}
+
+TEST(glyph_table_lookup) {
+    std::vector<uint8_t> data = makeUniFont();
+    shx::ShxFont font;
+    ASSERT_TRUE(font.loadFromMemory(data.data(), data.size()));
+    ASSERT_EQ(font.getGlyphCount(), 5u);
+
+    ASSERT_TRUE(font.hasGlyph(0x0041));
+    ASSERT_TRUE(font.hasGlyph(0x4E2D));
+    ASSERT_TRUE(font.hasGlyph(0xFFFF));
+    ASSERT_FALSE(font.hasGlyph(0x0042));   // same page, empty slot
+    ASSERT_FALSE(font.hasGlyph(0x4E2C));
+    ASSERT_FALSE(font.hasGlyph(0x1200));   // page never allocated
+    ASSERT_FALSE(font.hasGlyph(0x10041));  // must not alias 0x0041
+    ASSERT_TRUE(font.getGlyph(0x10041) == nullptr);
+    ASSERT_TRUE(font.getGlyphByShape(0x4E2E) == font.getGlyph(0x4E2E));
+
+    const shx::Glyph* redefined = font.getGlyph(0x4E2D);
+    ASSERT_TRUE(redefined != nullptr);
+    ASSERT_EQ(redefined->code, 0x4E2Du);
+    ASSERT_TRUE(std::abs(redefined->width - 2.0) < 1e-9);
+
+    // Sub-shape 'A' is inlined: line north, move back, line east
+    const shx::Glyph* composite = font.getGlyph(0x4E2E);
+    ASSERT_TRUE(composite != nullptr);
+    ASSERT_EQ(composite->commands.size(), 3u);
+    ASSERT_TRUE(composite->commands[0].type == shx::CommandType::LineTo);
+    ASSERT_TRUE(std::abs(composite->commands[0].endPoint.y - 1.0) < 1e-9);
+    ASSERT_TRUE(std::abs(composite->commands[2].endPoint.x - 1.0) < 1e-9);
+
+    // Glyphs compile once: precompiling afterwards leaves them untouched
+    font.precompile();
+    ASSERT_TRUE(font.getGlyph(0x4E2E) == composite);
+    ASSERT_EQ(composite->commands.size(), 3u);
+}
+
+TEST(load_mapped_and_memory) {
+    const char* path = "shx_test_unifont.shx";
+    {
+        std::vector<uint8_t> data = makeUniFont();
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    shx::ShxFont mapped;
+    bool loaded = mapped.load(path);
+    std::remove(path);
+    ASSERT_TRUE(loaded);
+
+    // The caller's buffer is released before any glyph is compiled
+    shx::ShxFont copied;
+    {
+        std::vector<uint8_t> data = makeUniFont();
+        ASSERT_TRUE(copied.loadFromMemory(data.data(), data.size()));
+    }
+
+    for (uint32_t code : {0x0041u, 0x4E2Du, 0x4E2Eu, 0xFFFFu}) {
+        const shx::Glyph* a = mapped.getGlyph(code);
+        const shx::Glyph* b = copied.getGlyph(code);
+        ASSERT_TRUE(a != nullptr && b != nullptr);
+        ASSERT_EQ(a->rawData.size(), b->rawData.size());
+        ASSERT_TRUE(std::memcmp(a->rawData.data(), b->rawData.data(), a->rawData.size()) == 0);
+        ASSERT_EQ(a->commands.size(), b->commands.size());
+    }
+
+    // Reloading replaces the previous glyphs
+    ASSERT_FALSE(mapped.load("nonexistent_file.shx"));
+    ASSERT_FALSE(mapped.isValid());
+    ASSERT_EQ(mapped.getGlyphCount(), 0u);
+}
+
+TEST(font_cache) {
+    const char* path = "shx_test_cache.shx";
+    const std::string cachePath = shx::defaultCachePath(path);
+    ASSERT_EQ(cachePath, std::string("shx_test_cache.shxc"));
+    std::remove(cachePath.c_str());
+
+    std::vector<uint8_t> data = makeUniFont();
+    auto writeFont = [&]() {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+    writeFont();
+
+    // First load builds the cache, second load uses it
+    shx::ShxFont built;
+    ASSERT_TRUE(built.loadCached(path, cachePath));
+    ASSERT_TRUE(std::ifstream(cachePath).good());
+
+    shx::ShxFont cached;
+    ASSERT_TRUE(cached.loadCached(path, cachePath));
+    ASSERT_EQ(cached.getGlyphCount(), built.getGlyphCount());
+    for (uint32_t code : {0x0041u, 0x4E2Du, 0x4E2Eu, 0xFFFFu, 0x0100u}) {
+        const shx::Glyph* a = built.getGlyph(code);
+        const shx::Glyph* b = cached.getGlyph(code);
+        ASSERT_TRUE(a != nullptr && b != nullptr);
+        ASSERT_TRUE(b->rawData.empty());
+        ASSERT_EQ(a->commands.size(), b->commands.size());
+        ASSERT_TRUE(a->width == b->width && a->height == b->height);
+        ASSERT_TRUE(a->inkBounds.valid == b->inkBounds.valid);
+        ASSERT_TRUE(a->inkBounds.minY == b->inkBounds.minY &&
+                    a->inkBounds.maxX == b->inkBounds.maxX);
+        for (size_t i = 0; i < a->commands.size(); ++i) {
+            ASSERT_TRUE(a->commands[i].type == b->commands[i].type);
+            ASSERT_TRUE(a->commands[i].endPoint.x == b->commands[i].endPoint.x);
+            ASSERT_TRUE(a->commands[i].endPoint.y == b->commands[i].endPoint.y);
+        }
+    }
+    ASSERT_FALSE(cached.hasGlyph(0x0042));
+
+    // Changed source bytes invalidate the cache
+    data[data.size() - 2] = 0x10; // last 0x4E2D definition: 1 unit east
+    writeFont();
+    shx::ShxFont changed;
+    ASSERT_TRUE(changed.loadCached(path, cachePath));
+    ASSERT_TRUE(std::abs(changed.getGlyph(0x4E2D)->width - 1.0) < 1e-9);
+    ASSERT_FALSE(changed.getGlyph(0x4E2D)->rawData.empty());
+
+    std::remove(path);
+    std::remove(cachePath.c_str());
+}
+
+TEST(layout_batch) {
+    std::vector<uint8_t> data = makeUniFont();
+    shx::ShxFont font;
+    ASSERT_TRUE(font.loadFromMemory(data.data(), data.size()));
+
+    // "A" is one unit north; "\xE4\xB8\xAD" (U+4E2D) two units east
+    std::vector<shx::TextRecord> records(2);
+    records[0].text = "A";
+    records[0].x = 10.0;
+    records[0].y = 20.0;
+    records[0].height = 2.0;
+    records[0].angle = 90.0;
+    records[1].text = "A\xE4\xB8\xAD";
+    records[1].widthFactor = 0.5;
+
+    shx::TextMesh mesh;
+    font.layoutBatch(records, mesh);
+    ASSERT_EQ(mesh.ranges.size(), 2u);
+    ASSERT_EQ(mesh.indices.size(), 6u);
+    ASSERT_EQ(mesh.vertexCount(), 6u);
+
+    // Rotated 90 degrees: north becomes west, scaled by the height
+    const shx::TextMesh::Range& first = mesh.ranges[0];
+    ASSERT_EQ(first.indexCount, 2u);
+    double x0 = mesh.vertices[2 * mesh.indices[0]];
+    double y0 = mesh.vertices[2 * mesh.indices[0] + 1];
+    double x1 = mesh.vertices[2 * mesh.indices[1]];
+    double y1 = mesh.vertices[2 * mesh.indices[1] + 1];
+    ASSERT_TRUE(std::abs(x0 - 10.0) < 1e-9 && std::abs(y0 - 20.0) < 1e-9);
+    ASSERT_TRUE(std::abs(x1 - 8.0) < 1e-9 && std::abs(y1 - 20.0) < 1e-9);
+
+    // Second glyph starts after the first one's advance (zero width for a
+    // vertical stroke) and is squeezed by the width factor
+    const shx::TextMesh::Range& second = mesh.ranges[1];
+    ASSERT_EQ(second.firstIndex, 2u);
+    ASSERT_EQ(second.indexCount, 4u);
+    uint32_t last = mesh.indices[second.firstIndex + 3];
+    ASSERT_TRUE(std::abs(mesh.vertices[2 * last] - 1.0) < 1e-9);
+    ASSERT_TRUE(std::abs(second.advance - 1.0) < 1e-9);
+
+    // Appending keeps earlier ranges intact
+    font.layoutBatch(records, mesh);
+    ASSERT_EQ(mesh.ranges.size(), 4u);
+    ASSERT_EQ(mesh.ranges[2].firstIndex, 6u);
+}
+
+TEST(ink_bounds) {
+    std::vector<uint8_t> data = makeUniFont();
+    shx::ShxFont font;
+    ASSERT_TRUE(font.loadFromMemory(data.data(), data.size()));
+
+    const shx::Glyph* line = font.getGlyph(0x0041);
+    ASSERT_TRUE(line->inkBounds.valid);
+    ASSERT_TRUE(line->inkBounds.height() == 1.0 && line->inkBounds.width() == 0.0);
+
+    // Semicircle on the chord (0,0)-(3,1), bulging below it: the extremes
+    // at 270 and 0 degrees fall between the compiled arc end points
+    const shx::Glyph* arc = font.getGlyph(0x0100);
+    ASSERT_TRUE(arc->inkBounds.valid);
+    double r = std::sqrt(2.5);
+    ASSERT_TRUE(std::abs(arc->inkBounds.minX - 0.0) < 1e-5);
+    ASSERT_TRUE(std::abs(arc->inkBounds.maxX - (1.5 + r)) < 1e-5);
+    ASSERT_TRUE(std::abs(arc->inkBounds.minY - (0.5 - r)) < 1e-5);
+    ASSERT_TRUE(std::abs(arc->inkBounds.maxY - 1.0) < 1e-5);
+}
+
+TEST(arc_flattening) {
+    // Quarter circle of radius 10 around the origin, through 45 degrees
+    double h = 10.0 * std::sqrt(0.5);
+    std::vector<double> chords;
+    size_t n = shx::flattenArc(10.0, 0.0, h, h, 0.0, 10.0, 0.01, chords);
+    ASSERT_TRUE(n > 1);
+    ASSERT_EQ(chords.size(), 2 * n);
+    ASSERT_TRUE(chords[2 * n - 2] == 0.0 && chords[2 * n - 1] == 10.0);
+
+    // Every vertex on the circle, every chord midpoint within tolerance
+    double px = 10.0, py = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double x = chords[2 * i], y = chords[2 * i + 1];
+        ASSERT_TRUE(std::abs(std::hypot(x, y) - 10.0) < 1e-9);
+        ASSERT_TRUE(10.0 - std::hypot((px + x) / 2, (py + y) / 2) <= 0.01 + 1e-12);
+        px = x;
+        py = y;
+    }
+
+    // Collinear points are a straight stroke
+    chords.clear();
+    ASSERT_EQ(shx::flattenArc(0.0, 0.0, 1.0, 1.0, 2.0, 2.0, 0.01, chords), 1u);
+
+    // A flattening font compiles the bulge arc to line segments only
+    std::vector<uint8_t> data = makeUniFont();
+    shx::ShxFont font;
+    font.setArcTolerance(0.001);
+    ASSERT_TRUE(font.loadFromMemory(data.data(), data.size()));
+    const shx::Glyph* arc = font.getGlyph(0x0100);
+    ASSERT_TRUE(arc->commands.size() > 4);
+    for (const shx::DrawCommand& cmd : arc->commands) {
+        ASSERT_TRUE(cmd.type != shx::CommandType::ArcTo);
+    }
+    shx::DrawCommand last = arc->commands[arc->commands.size() - 1];
+    ASSERT_TRUE(std::abs(last.endPoint.x - 3.0) < 1e-6 &&
+                std::abs(last.endPoint.y - 1.0) < 1e-6);
+    double r = std::sqrt(2.5);
+    ASSERT_TRUE(std::abs(arc->inkBounds.minY - (0.5 - r)) < 0.001 + 1e-6);
+}
+
+TEST(concurrent_use) {
+    std::vector<uint8_t> data = makeUniFont();
+    shx::ShxFont font;
+    ASSERT_TRUE(font.loadFromMemory(data.data(), data.size()));
+
+    std::vector<shx::TextRecord> records(200);
+    for (size_t i = 0; i < records.size(); ++i) {
+        records[i].text = (i % 2) ? "A\xE4\xB8\xAD" : "\xC4\x80" "A";
+        records[i].x = 10.0 * i;
+        records[i].height = 2.0;
+        records[i].angle = 3.0 * i;
+    }
+
+    // Glyphs are still uncompiled: threads race on the first lookups
+    shx::TextMesh parallel;
+    font.layoutParallel(records, parallel, shx::LayoutOptions(), 8);
+
+    std::vector<std::thread> threads;
+    std::vector<double> widths(8);
+    for (size_t t = 0; t < widths.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            shx::PathCollector collector;
+            for (int i = 0; i < 50; ++i) {
+                font.render(collector, records[t].text, 2.0);
+            }
+            widths[t] = font.measureText(records[t].text, 2.0);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    shx::TextMesh serial;
+    font.layoutBatch(records, serial);
+    ASSERT_TRUE(parallel.vertices == serial.vertices);
+    ASSERT_TRUE(parallel.indices == serial.indices);
+    ASSERT_EQ(parallel.ranges.size(), serial.ranges.size());
+    for (size_t i = 0; i < serial.ranges.size(); ++i) {
+        ASSERT_EQ(parallel.ranges[i].firstIndex, serial.ranges[i].firstIndex);
+        ASSERT_EQ(parallel.ranges[i].indexCount, serial.ranges[i].indexCount);
+    }
+    for (size_t t = 0; t < widths.size(); ++t) {
+        ASSERT_EQ(widths[t], font.measureText(records[t].text, 2.0));
+    }
+}
+
+// Minimal in-memory bigfont with GBK codes: lead bytes 0xB0-0xF7 only
+static std::vector<uint8_t> makeBigFont() {
+    std::vector<uint8_t> data;
+    const std::string header = "AutoCAD-86 bigfont 1.0\r\n\x1A";
+    data.insert(data.end(), header.begin(), header.end());
+
+    auto u16 = [&](uint16_t v) {
+        data.push_back(v & 0xFF);
+        data.push_back(v >> 8);
+    };
+    const std::vector<std::pair<uint16_t, std::vector<uint8_t>>> shapes = {
+        {0x0000, {'T', 0, 8, 2, 0}},         // name, above, below, modes
+        {0x0041, {4, 0x14, 0x00}},           // 'A': width, 1 unit north
+        {0xD6D0, {8, 0, 0x20, 0x00}},        // GBK D6D0 (U+4E2D): 2 units east
+    };
+
+    u16(static_cast<uint16_t>(shapes.size())); u16(0); // count, length
+    u16(1); u16(0xB0); u16(0xF7);                       // one lead-byte range
+    uint32_t offset = static_cast<uint32_t>(data.size() + 8 * shapes.size());
+    for (const auto& shape : shapes) {
+        u16(shape.first);
+        u16(static_cast<uint16_t>(shape.second.size()));
+        u16(offset & 0xFFFF);
+        u16(offset >> 16);
+        offset += static_cast<uint32_t>(shape.second.size());
+    }
+    for (const auto& shape : shapes) {
+        data.insert(data.end(), shape.second.begin(), shape.second.end());
+    }
+    return data;
+}
+
+TEST(gbk_mapping) {
+    ASSERT_EQ(shx::unicodeToGbk(0x41), 0x41u);
+    ASSERT_EQ(shx::unicodeToGbk(0x4E2D), 0xD6D0u);  // 中
+    ASSERT_EQ(shx::unicodeToGbk(0x00E9), 0xA8A6u);  // é
+    ASSERT_EQ(shx::unicodeToGbk(0x0E01), 0u);       // Thai, not in GBK
+    ASSERT_EQ(shx::unicodeToGbk(0x1F600), 0u);
+
+    // Decoding: ASCII, 3-byte, stray continuation byte, truncated sequence
+    const std::string text = "A\xE4\xB8\xAD\x80\xE4\xB8";
+    size_t pos = 0;
+    ASSERT_EQ(shx::nextCodePoint(text, pos), 0x41u);
+    ASSERT_EQ(shx::nextCodePoint(text, pos), 0x4E2Du);
+    ASSERT_EQ(shx::nextCodePoint(text, pos), 0xFFFDu);
+    ASSERT_EQ(shx::nextCodePoint(text, pos), 0xFFFDu);
+    ASSERT_EQ(pos, text.size());
+
+    std::vector<uint8_t> data = makeBigFont();
+    shx::ShxFont font;
+    ASSERT_TRUE(font.loadFromMemory(data.data(), data.size()));
+    ASSERT_EQ(font.getDoubleByteRanges().size(), 1u);
+    ASSERT_EQ(font.mapCodePoint(0x41), 0x41u);
+    ASSERT_EQ(font.mapCodePoint(0x4E2D), 0xD6D0u);
+    ASSERT_EQ(font.mapCodePoint(0x00E9), 0u);       // lead byte 0xA8 not in range
+
+    // UTF-8 text renders through the GBK codes
+    shx::PathCollector collector;
+    font.render(collector, "\xE4\xB8\xAD", 8.0);
+    ASSERT_EQ(collector.commands.size(), 1u);
+    ASSERT_TRUE(std::abs(collector.commands[0].endPoint.x - 2.0) < 1e-6);
+    ASSERT_TRUE(std::abs(font.measureText("\xE4\xB8\xAD", 8.0) - 2.0) < 1e-6);
+
+    // The ranges survive a cache round trip
+    const char* path = "shx_test_bigfont.shx";
+    const std::string cachePath = shx::defaultCachePath(path);
+    std::remove(cachePath.c_str());
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+    shx::ShxFont built, cached;
+    ASSERT_TRUE(built.loadCached(path, cachePath));
+    ASSERT_TRUE(cached.loadCached(path, cachePath));
+    ASSERT_TRUE(cached.getGlyph(0xD6D0)->rawData.empty());
+    ASSERT_TRUE(cached.getDoubleByteRanges() == font.getDoubleByteRanges());
+    ASSERT_EQ(cached.mapCodePoint(0x4E2D), 0xD6D0u);
+    std::remove(path);
+    std::remove(cachePath.c_str());
+}
+
 //=============================================================================
 // Integration Tests (require actual SHX file)
 //=============================================================================
@@ -198,6 +585,14 @@ int main(int argc, char* argv[]) {
     RUN_TEST(shx_font_invalid_file);
     RUN_TEST(is_valid_shx_file);
     RUN_TEST(shx_font_move);
+    RUN_TEST(glyph_table_lookup);
+    RUN_TEST(load_mapped_and_memory);
+    RUN_TEST(font_cache);
+    RUN_TEST(layout_batch);
+    RUN_TEST(ink_bounds);
+    RUN_TEST(arc_flattening);
+    RUN_TEST(concurrent_use);
+    RUN_TEST(gbk_mapping);
     
     if (argc > 1) {
         runIntegrationTests(argv[1]);
@@ -0,0 +1,79 @@
+"""
+Generates src/GbkTable.inc: Unicode (BMP) -> GBK (code page 936) double-byte
+codes for BigFont lookups, from Python's gbk codec.
+
+The table is two-level like the glyph table: GBK_PAGE_INDEX maps the high
+byte of a code point to a 256-entry block of GBK_PAGES (block 0 is empty),
+so a lookup is two loads and no locale or iconv is involved.
+
+Usage:
+    python gen_gbk_table.py [output]     (default: ../src/GbkTable.inc)
+"""
+
+import os
+import sys
+
+DEFAULT_OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                              "..", "src", "GbkTable.inc")
+
+
+def build_pages():
+    pages = {}
+    for cp in range(0x80, 0x10000):
+        if 0xD800 <= cp < 0xE000:
+            continue  # surrogates
+        try:
+            encoded = chr(cp).encode("gbk")
+        except UnicodeEncodeError:
+            continue
+        if len(encoded) != 2:
+            continue  # single-byte codes other than ASCII are not BigFont codes
+        page = pages.setdefault(cp >> 8, [0] * 256)
+        page[cp & 0xFF] = (encoded[0] << 8) | encoded[1]
+    return pages
+
+
+def write_table(path, pages):
+    order = sorted(pages)
+    index = [0] * 256
+    for block, high in enumerate(order, start=1):
+        index[high] = block
+
+    lines = [
+        "// Generated by tools/gen_gbk_table.py from Python's gbk codec",
+        "// (code page 936). Do not edit.",
+        f"// {sum(1 for p in pages.values() for c in p if c)} characters"
+        f" in {len(order)} pages.",
+        "",
+        "// Block of GBK_PAGES per code point high byte, 0 = no GBK characters",
+        "static const uint8_t GBK_PAGE_INDEX[256] = {",
+    ]
+    for row in range(0, 256, 16):
+        lines.append("    " + ", ".join(f"{v:3d}" for v in index[row:row + 16]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("// GBK code (lead byte high) per code point low byte, 0 = unmapped")
+    lines.append(f"static const uint16_t GBK_PAGES[{len(order) + 1}][256] = {{")
+    lines.append("    {0},")
+    for high in order:
+        lines.append(f"    // U+{high:02X}00")
+        lines.append("    {")
+        page = pages[high]
+        for row in range(0, 256, 8):
+            lines.append("        " + ", ".join(f"0x{v:04X}" for v in page[row:row + 8]) + ",")
+        lines.append("    },")
+    lines.append("};")
+
+    with open(path, "w", newline="\n") as out:
+        out.write("\n".join(lines) + "\n")
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else DEFAULT_OUTPUT
+    pages = build_pages()
+    write_table(path, pages)
+    print(f"{path}: {len(pages)} pages")
+
+
+if __name__ == "__main__":
+    main()
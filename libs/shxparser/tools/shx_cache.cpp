@@ -0,0 +1,78 @@
+/*
+ * SHX Font Cache Builder
+ * Precompiles SHX fonts into .shxc caches so applications can map them at
+ * startup instead of parsing and compiling glyphs.
+ *
+ * Usage: shx_cache [-o <dir>] <shx_file>...
+ */
+
+#include "ShxParser.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static std::string outputPath(const std::string& font, const std::string& dir) {
+    std::string cache = shx::defaultCachePath(font);
+    if (dir.empty()) {
+        return cache;
+    }
+    size_t slash = cache.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? cache : cache.substr(slash + 1);
+    char last = dir.back();
+    return (last == '/' || last == '\\') ? dir + name : dir + "/" + name;
+}
+
+int main(int argc, char* argv[]) {
+    std::string outputDir;
+    std::vector<std::string> fonts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else {
+            fonts.push_back(arg);
+        }
+    }
+
+    if (fonts.empty()) {
+        std::cout << "Usage: " << argv[0] << " [-o <dir>] <shx_file>...\n";
+        return 1;
+    }
+
+    int failures = 0;
+    for (const std::string& fontFile : fonts) {
+        std::string cacheFile = outputPath(fontFile, outputDir);
+        auto start = std::chrono::steady_clock::now();
+
+        shx::ShxFont font;
+        if (!font.load(fontFile)) {
+            std::cerr << fontFile << ": " << font.getLastError() << "\n";
+            failures++;
+            continue;
+        }
+        if (!font.saveCache(cacheFile)) {
+            std::cerr << fontFile << ": cannot write " << cacheFile << "\n";
+            failures++;
+            continue;
+        }
+
+        // Verify the cache is accepted for this source
+        shx::ShxFont cached;
+        if (!cached.loadCached(fontFile, cacheFile) ||
+            cached.getGlyphCount() != font.getGlyphCount()) {
+            std::cerr << fontFile << ": cache verification failed\n";
+            failures++;
+            continue;
+        }
+
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << fontFile << " -> " << cacheFile << " ("
+                  << font.getGlyphCount() << " glyphs, " << std::fixed
+                  << std::setprecision(1) << ms << " ms)\n";
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+"""
+JHB 正文压缩基准：各构件类型 x 编码/压缩级别 的端到端耗时与传输体积。
+
+端到端耗时 = 发出请求 -> 收完响应 -> 正文解压完成，
+与客户端 JhbDecoder 的流程一致（不含 B-rep 解析，它与压缩无关）。
+
+用法:
+    python bench_compression.py [--url http://127.0.0.1:8000] [--repeat 3]
+                                [--types Pile Chengtai ...]
+
+zstd 需要服务端与本脚本均安装 zstandard；服务端不支持的编码会回退为 identity 并被跳过。
+"""
+
+import argparse
+import json
+import statistics
+import struct
+import time
+import urllib.request
+import zlib
+
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+PART_TYPES = ["Pile", "Chengtai", "Dunshen", "TuopanDingmao",
+              "bed_stone", "bearing", "girder", "BridgePier2"]
+
+LEVELS = {
+    "identity": [None],
+    "deflate": [1, 3, 6, 9],
+    "zstd": [1, 3, 9, 19],
+}
+
+
+def decode_body(body: bytes, encoding: str) -> bytes:
+    if encoding == "deflate":
+        return zlib.decompress(body)
+    if encoding == "zstd":
+        return zstandard.ZstdDecompressor().decompress(body)
+    return body
+
+
+def generate(url: str, model_type: str, encoding: str, level):
+    req = {"model_type": model_type, "args": {}, "format": "brep"}
+    if encoding != "identity":
+        req["accept_encoding"] = [encoding]
+        req["compression_level"] = level
+
+    data = json.dumps(req).encode("utf-8")
+    http_req = urllib.request.Request(
+        f"{url}/api/v1/model/generate", data=data,
+        headers={"Content-Type": "application/json"})
+
+    start = time.perf_counter()
+    with urllib.request.urlopen(http_req, timeout=300) as resp:
+        package = resp.read()
+    header_len = struct.unpack("<I", package[:4])[0]
+    metadata = json.loads(package[4:4 + header_len].decode("utf-8"))
+    body = package[4 + header_len:]
+    actual = metadata.get("bodyEncoding", "identity")
+    plain = decode_body(body, actual)
+    elapsed = (time.perf_counter() - start) * 1000.0
+
+    return actual, elapsed, len(body), len(plain)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="JHB 正文压缩基准")
+    parser.add_argument("--url", default="http://127.0.0.1:8000")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--types", nargs="*", default=PART_TYPES)
+    opts = parser.parse_args()
+
+    print(f"{'part':<14}{'encoding':<10}{'level':>6}{'raw KB':>12}"
+          f"{'wire KB':>12}{'ratio':>8}{'median ms':>12}")
+    for model_type in opts.types:
+        # 预热：服务端首次编译脚本、工作进程导入 cadquery 不计入结果
+        generate(opts.url, model_type, "identity", None)
+
+        for encoding, levels in LEVELS.items():
+            if encoding == "zstd" and zstandard is None:
+                continue
+            for level in levels:
+                samples = []
+                for _ in range(opts.repeat):
+                    actual, elapsed, wire, raw = generate(
+                        opts.url, model_type, encoding, level)
+                    if actual != encoding:
+                        break  # 服务端不支持该编码
+                    samples.append(elapsed)
+                if not samples:
+                    continue
+                print(f"{model_type:<14}{encoding:<10}{str(level or '-'):>6}"
+                      f"{raw / 1024:>12.1f}{wire / 1024:>12.1f}"
+                      f"{raw / max(wire, 1):>8.2f}{statistics.median(samples):>12.1f}")
+
+
+if __name__ == "__main__":
+    main()
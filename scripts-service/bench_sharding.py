@@ -0,0 +1,141 @@
+"""
+多实例分片基准：同机启动 1..N 个服务实例，批量生成 BridgePier2，比较吞吐随实例数的变化。
+
+各组的工作进程总数相同（--workers，平均分给各实例），
+因此结果反映的是单个 FastAPI 主进程（JHB 封装、管道收发、事件循环）成为瓶颈时的扩展性。
+客户端按最少未完成请求分配任务，与桌面端 QTOCCT_SERVICE_ENDPOINTS 的策略一致。
+
+用法:
+    python bench_sharding.py [--instances 4] [--jobs 200] [--concurrency 64]
+                             [--workers 24] [--base-port 8100]
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+from concurrent.futures import ThreadPoolExecutor
+
+SERVICE_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "main.py")
+
+
+class LeastOutstanding:
+    """最少未完成请求分配"""
+
+    def __init__(self, urls):
+        self.urls = urls
+        self.outstanding = [0] * len(urls)
+        self.served = [0] * len(urls)
+        self.lock = threading.Lock()
+
+    def acquire(self) -> int:
+        with self.lock:
+            index = min(range(len(self.urls)), key=lambda i: self.outstanding[i])
+            self.outstanding[index] += 1
+            return index
+
+    def release(self, index: int):
+        with self.lock:
+            self.outstanding[index] -= 1
+            self.served[index] += 1
+
+
+def start_instances(count: int, base_port: int, workers: int):
+    per_instance = max(1, workers // count)
+    env = dict(os.environ)
+    # 启动即预热全部进程，计时不含扩容
+    env["OCCT_POOL_MAX"] = str(per_instance)
+    env["OCCT_POOL_MIN"] = str(per_instance)
+    procs, urls = [], []
+    for i in range(count):
+        port = base_port + i
+        procs.append(subprocess.Popen(
+            [sys.executable, SERVICE_SCRIPT, "--port", str(port)], env=env,
+            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+        urls.append(f"http://127.0.0.1:{port}")
+    return procs, urls
+
+
+def wait_ready(url: str, timeout: float = 180.0):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            with urllib.request.urlopen(f"{url}/api/v1/ready", timeout=5) as resp:
+                if resp.status == 200:
+                    return
+        except (urllib.error.URLError, ConnectionError):
+            pass  # 503（预热中）或尚未监听
+        time.sleep(0.5)
+    raise TimeoutError(f"{url} 未在 {timeout:.0f}s 内就绪")
+
+
+def generate(url: str, y_offset: float) -> int:
+    req = {"model_type": "BridgePier2", "args": {"yOffset": y_offset},
+           "format": "brep"}
+    http_req = urllib.request.Request(
+        f"{url}/api/v1/model/generate", data=json.dumps(req).encode("utf-8"),
+        headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(http_req, timeout=600) as resp:
+        return len(resp.read())
+
+
+def run_batch(urls, jobs: int, concurrency: int):
+    balancer = LeastOutstanding(urls)
+
+    def job(i: int) -> int:
+        index = balancer.acquire()
+        try:
+            return generate(urls[index], i * 31600.0)
+        finally:
+            balancer.release(index)
+
+    # 预热：各实例编译脚本、建立几何缓存
+    for url in urls:
+        generate(url, 0.0)
+
+    started = time.perf_counter()
+    with ThreadPoolExecutor(max_workers=concurrency) as pool:
+        total_bytes = sum(pool.map(job, range(jobs)))
+    elapsed = time.perf_counter() - started
+    return elapsed, total_bytes, balancer.served
+
+
+def main():
+    parser = argparse.ArgumentParser(description="多实例分片吞吐基准")
+    parser.add_argument("--instances", type=int, default=4, help="最大实例数 N，依次测试 1..N")
+    parser.add_argument("--jobs", type=int, default=200)
+    parser.add_argument("--concurrency", type=int, default=64, help="客户端并发请求数")
+    parser.add_argument("--workers", type=int, default=max(1, (os.cpu_count() or 4) * 3 // 4),
+                        help="各组工作进程总数")
+    parser.add_argument("--base-port", type=int, default=8100)
+    opts = parser.parse_args()
+
+    print(f"{'instances':>10}{'workers':>9}{'seconds':>10}{'jobs/s':>9}{'speedup':>9}"
+          f"{'MB':>9}  per-instance")
+    baseline = None
+    for count in range(1, opts.instances + 1):
+        procs, urls = start_instances(count, opts.base_port, opts.workers)
+        try:
+            for url in urls:
+                wait_ready(url)
+            elapsed, total_bytes, served = run_batch(urls, opts.jobs, opts.concurrency)
+        finally:
+            for proc in procs:
+                proc.terminate()
+            for proc in procs:
+                proc.wait()
+
+        throughput = opts.jobs / elapsed
+        baseline = baseline or throughput
+        print(f"{count:>10}{max(1, opts.workers // count) * count:>9}{elapsed:>10.2f}"
+              f"{throughput:>9.1f}{throughput / baseline:>9.2f}"
+              f"{total_bytes / 1e6:>9.1f}  {served}")
+
+
+if __name__ == "__main__":
+    main()
@@ -7,13 +7,21 @@ import sys
 import uuid
 import json
 import asyncio
+import bisect
 import logging
 import struct
-from fastapi import FastAPI, HTTPException, Response
+import time
+import hashlib
+import zlib
+from collections import OrderedDict, deque
+from dataclasses import dataclass, field
+
+from worker_protocol import pack_frame, read_frame_async
+from fastapi import FastAPI, HTTPException, Request, Response
 from fastapi.staticfiles import StaticFiles
 from fastapi.middleware.cors import CORSMiddleware
 from pydantic import BaseModel
-from typing import Dict, Any, Optional
+from typing import Dict, Any, List, NamedTuple, Optional
 
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger("ModelingService")
@@ -31,19 +39,58 @@ app.add_middleware(
 WORKSPACE = os.path.abspath(os.path.join(os.path.dirname(__file__), "workspace"))
 WEB_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "web"))
 os.makedirs(WORKSPACE, exist_ok=True)
+
+# 同机交付目录：Linux 下位于 /dev/shm（内存文件系统），其余平台退回工作区子目录
+# 客户端映射文件后自行删除；遗留文件超过 HANDOFF_TTL 秒后由服务端清理
+HANDOFF_DIR = ("/dev/shm/occt-handoff" if os.path.isdir("/dev/shm")
+               else os.path.join(WORKSPACE, "handoff"))
+HANDOFF_TTL = 300
+os.makedirs(HANDOFF_DIR, exist_ok=True)
+LOOPBACK_HOSTS = {"127.0.0.1", "::1", "localhost"}
 os.makedirs(WEB_DIR, exist_ok=True)
 
 POOL_WORKER_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "pool_worker.py")
 FALLBACK_WORKER_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "worker.py")
 
-# 工作进程池大小（建议 CPU 核心数的 50-75%）
-POOL_SIZE = 8
+# 工作进程池大小：按 CPU 核心数确定上下限（上限约为核心数的 75%），
+# 可通过环境变量 OCCT_POOL_MIN / OCCT_POOL_MAX 覆盖
+_CPU_COUNT = os.cpu_count() or 4
+POOL_MAX_SIZE = int(os.environ.get("OCCT_POOL_MAX", max(1, _CPU_COUNT * 3 // 4)))
+POOL_MIN_SIZE = int(os.environ.get("OCCT_POOL_MIN", max(1, min(POOL_MAX_SIZE, _CPU_COUNT // 4))))
+POOL_IDLE_TIMEOUT = 120.0   # 多余进程空闲超过该秒数后回收
+POOL_REAP_INTERVAL = 10.0
+AFFINITY_WINDOW = 8         # 亲和调度只在队首若干个排队请求中查找，避免饿死
+QUEUE_WAIT_SAMPLES = 1000   # 排队等待时间统计的样本窗口
+
+# 阶段耗时直方图的桶上界（毫秒）与统计的阶段：
+# warmup 进程预热、queue_wait 排队、exec 脚本执行、export 导出、
+# ipc 管道往返（不含执行/导出）、package JHB 封装、total 请求总耗时
+METRIC_BUCKETS_MS = (1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000, 60000)
+METRIC_STAGES = ("warmup", "queue_wait", "exec", "export", "ipc", "package", "total")
+
+# 服务端脚本文本缓存容量（按 SHA-256 哈希索引）
+SCRIPT_CACHE_SIZE = 256
+
+# JHB 正文压缩：zstd 为可选依赖 (pip install zstandard)，deflate 使用标准库 zlib
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+BODY_ENCODINGS = (["zstd"] if zstandard else []) + ["deflate"]
+DEFAULT_COMPRESSION_LEVEL = {"zstd": 3, "deflate": 1}
 
 class ScriptRequest(BaseModel):
-    code: str
+    code: Optional[str] = ""
+    code_hash: Optional[str] = None # 脚本 SHA-256；仅发送哈希时由服务端缓存补全脚本
     args: Dict[str, Any] = {}
     model_type: Optional[str] = None
     format: Optional[str] = "step" # Default to 'step' but can be 'brep'
+    accept_encoding: Optional[List[str]] = None # 客户端可解压的正文编码（按偏好排序），缺省不压缩
+    compression_level: Optional[int] = None
+    header_format: Optional[str] = "json" # "cbor": 二进制头部，schema 以 schemaId 引用
+    transport: Optional[str] = "http" # "local": 同机客户端直接映射结果文件，响应不含正文
+    artifact: Optional[bool] = False # 在工作区保留模型文件，供 /api/v1/model/download 下载
 
 
 def _get_worker_env():
@@ -58,38 +105,356 @@ def _get_worker_env():
 _WORKER_ENV = _get_worker_env()
 
 
+def script_hash(code: str) -> str:
+    """脚本内容哈希，与客户端 QCryptographicHash::Sha256 的十六进制结果一致"""
+    return hashlib.sha256(code.encode("utf-8")).hexdigest()
+
+
+def negotiate_body_encoding(accepted: Optional[List[str]]) -> str:
+    """按客户端偏好顺序选择双方都支持的正文编码"""
+    for encoding in accepted or []:
+        if encoding in BODY_ENCODINGS:
+            return encoding
+    return "identity"
+
+
+def encode_body(data: bytes, encoding: str, level: Optional[int] = None) -> bytes:
+    """压缩 JHB 正文；deflate 输出 zlib 格式流，zstd 输出单帧"""
+    if encoding == "identity":
+        return data
+    if level is None:
+        level = DEFAULT_COMPRESSION_LEVEL[encoding]
+    if encoding == "zstd":
+        return zstandard.ZstdCompressor(level=level).compress(data)
+    return zlib.compress(data, level)
+
+
+def load_body(path: Optional[str], geometry: bytes, encoding: str,
+              level: Optional[int] = None) -> "tuple[int, bytes]":
+    """读取结果文件（无文件时取内存中的几何）并编码，返回 (原始大小, 正文)"""
+    if path:
+        with open(path, "rb") as f:
+            data = f.read()
+    else:
+        data = geometry
+    return len(data), encode_body(data, encoding, level)
+
+
+class ScriptCache:
+    """
+    脚本文本 LRU 缓存。
+    客户端优先只发送 code_hash，未命中时返回 409，由客户端补传全文。
+    """
+
+    def __init__(self, capacity: int = SCRIPT_CACHE_SIZE):
+        self.capacity = capacity
+        self._scripts: "OrderedDict[str, str]" = OrderedDict()
+
+    def put(self, code: str) -> str:
+        key = script_hash(code)
+        self._scripts[key] = code
+        self._scripts.move_to_end(key)
+        while len(self._scripts) > self.capacity:
+            self._scripts.popitem(last=False)
+        return key
+
+    def get(self, key: str) -> Optional[str]:
+        code = self._scripts.get(key)
+        if code is not None:
+            self._scripts.move_to_end(key)
+        return code
+
+
+script_cache = ScriptCache()
+
+
+class Histogram:
+    """固定桶耗时直方图；分位数取所在桶的上界"""
+
+    def __init__(self):
+        self.buckets = [0] * (len(METRIC_BUCKETS_MS) + 1)
+        self.count = 0
+        self.total_ms = 0.0
+        self.max_ms = 0.0
+
+    def observe(self, seconds: float):
+        ms = seconds * 1000.0
+        self.buckets[bisect.bisect_left(METRIC_BUCKETS_MS, ms)] += 1
+        self.count += 1
+        self.total_ms += ms
+        self.max_ms = max(self.max_ms, ms)
+
+    def quantile(self, q: float) -> float:
+        if not self.count:
+            return 0.0
+        rank = q * self.count
+        seen = 0
+        for i, n in enumerate(self.buckets):
+            seen += n
+            if seen >= rank and n:
+                return float(METRIC_BUCKETS_MS[i]) if i < len(METRIC_BUCKETS_MS) else self.max_ms
+        return self.max_ms
+
+    def snapshot(self) -> Dict[str, Any]:
+        return {
+            "count": self.count,
+            "sumMs": round(self.total_ms, 2),
+            "meanMs": round(self.total_ms / self.count, 2) if self.count else 0.0,
+            "p50Ms": self.quantile(0.5),
+            "p95Ms": self.quantile(0.95),
+            "maxMs": round(self.max_ms, 2),
+            "buckets": [{"le": le, "count": n}
+                        for le, n in zip(list(METRIC_BUCKETS_MS) + ["inf"], self.buckets)]
+        }
+
+
+class ServiceMetrics:
+    """按阶段统计的请求耗时，配合工作进程池的实时指标由 /api/v1/metrics 提供"""
+
+    def __init__(self):
+        self.stages = {stage: Histogram() for stage in METRIC_STAGES}
+        self.started_at = time.time()
+        self.requests = 0
+        self.failed = 0
+        self.in_flight = 0
+
+    def observe(self, stage: str, seconds: float):
+        self.stages[stage].observe(max(0.0, seconds))
+
+    def snapshot(self, pool_gauges: Dict[str, Any]) -> Dict[str, Any]:
+        return {
+            "uptimeSeconds": round(time.time() - self.started_at, 1),
+            "requests": {
+                "total": self.requests,
+                "failed": self.failed,
+                "inFlight": self.in_flight
+            },
+            "pool": pool_gauges,
+            "stages": {name: hist.snapshot() for name, hist in self.stages.items()}
+        }
+
+
+metrics = ServiceMetrics()
+
+
+class WorkerResult(NamedTuple):
+    """工作进程返回的任务结果"""
+    success: bool
+    args: Dict[str, Any] = {}
+    geometry: bytes = b""   # 内联返回的模型；写入 output_path 时为空
+    error: str = ""         # 脚本异常 traceback
+    cache: Dict[str, Any] = {}  # 本次任务的几何缓存命中统计
+
+
+@dataclass
+class PoolWorker:
+    """工作进程及其调度/统计状态"""
+    proc: Any
+    started_at: float = field(default_factory=time.monotonic)
+    model_type: Optional[str] = None    # 最近执行的模型类型，用于亲和调度
+    scripts: set = field(default_factory=set)  # 已编译缓存的脚本哈希，命中时无需再发送源码
+    busy_since: Optional[float] = None
+    busy_seconds: float = 0.0
+    idle_since: float = field(default_factory=time.monotonic)
+    tasks: int = 0
+    affinity_hits: int = 0
+    geometry_cache: Dict[str, Any] = field(default_factory=dict)  # 进程内几何缓存累计统计
+
+    @property
+    def pid(self) -> int:
+        return self.proc.pid
+
+
 class WorkerPool:
     """
     预热的常驻工作进程池。
     每个工作进程在启动时完成 cadquery 的导入（约1-2秒），
     之后通过 stdin 管道持续接收任务，无需重复导入。
+
+    进程数在 [min_size, max_size] 之间随排队深度伸缩：有请求排队时扩容，
+    空闲超过 idle_timeout 的多余进程被回收。
+    调度优先选择上次执行同一 model_type 的空闲进程，复用其脚本缓存与几何缓存。
     """
     
-    def __init__(self, size: int = POOL_SIZE):
-        self.size = size
-        self.available: asyncio.Queue = asyncio.Queue()
-        self._all_workers = []
-        self._lock = asyncio.Lock()
-    
+    def __init__(self, min_size: int = POOL_MIN_SIZE, max_size: int = POOL_MAX_SIZE,
+                 idle_timeout: float = POOL_IDLE_TIMEOUT):
+        self.min_size = min_size
+        self.max_size = max(min_size, max_size)
+        self.idle_timeout = idle_timeout
+        self._workers: List[PoolWorker] = []
+        self._idle: List[PoolWorker] = []   # 按空闲先后排列，队首空闲最久
+        self._waiters: deque = deque()      # (model_type, future)
+        self._spawning = 0
+        self._next_id = 0
+        self._queue_waits: deque = deque(maxlen=QUEUE_WAIT_SAMPLES)
+        self._reaper = None
+        self._warmup = None
+        self.warmed = False                 # 首批 min_size 个进程的预热已结束
+
+    @property
+    def size(self) -> int:
+        return len(self._workers)
+
     async def start(self):
-        """启动所有工作进程并等待预热完成"""
-        logger.info(f"正在预热 {self.size} 个工作进程（导入 cadquery）...")
-        tasks = [self._spawn_worker(i) for i in range(self.size)]
-        results = await asyncio.gather(*tasks, return_exceptions=True)
-        
-        ready_count = 0
+        """启动最小数量的工作进程并等待预热完成"""
+        self.start_background()
+        await self._warmup
+
+    def start_background(self):
+        """
+        后台预热：服务立即开始接受连接，客户端通过就绪检查得知预热进度。
+        每个进程预热完成即投入使用，预热期间到达的请求排队等待。
+        """
+        count = max(0, self.min_size - self.size - self._spawning)
+        logger.info(f"正在预热 {count} 个工作进程（导入 cadquery），上限 {self.max_size} 个...")
+        # 同步计入 _spawning，预热期间到达的请求不会重复扩容
+        self._spawning += count
+        self._reaper = asyncio.ensure_future(self._reap_idle())
+        self._warmup = asyncio.ensure_future(self._warm(count))
+
+    async def _warm(self, count: int):
+        results = await asyncio.gather(*(self._grow() for _ in range(count)),
+                                       return_exceptions=True)
         for i, result in enumerate(results):
-            if isinstance(result, asyncio.subprocess.Process):
-                self._all_workers.append(result)
-                await self.available.put(result)
-                ready_count += 1
-            else:
-                logger.warning(f"工作进程 {i} 启动失败: {result}")
+            if isinstance(result, Exception):
+                logger.warning(f"工作进程 {i} 启动失败: {result!r}")
         
-        logger.info(f"工作进程池就绪: {ready_count}/{self.size} 个进程已预热")
-    
+        self.warmed = True
+        logger.info(f"工作进程池就绪: {self.size}/{self.min_size} 个进程已预热")
+
+    def readiness(self) -> Dict[str, Any]:
+        """就绪状态：首批进程预热结束且至少有一个可用进程"""
+        return {
+            "ready": self.warmed and self.size > 0,
+            "warming": not self.warmed,
+            "workers": self.size,
+            "minSize": self.min_size,
+            "spawning": self._spawning
+        }
+
+    def _take_id(self) -> int:
+        self._next_id += 1
+        return self._next_id
+
+    def _add(self, proc):
+        worker = PoolWorker(proc)
+        self._workers.append(worker)
+        self._release(worker)
+
+    def _schedule_spawn(self):
+        self._spawning += 1
+        asyncio.ensure_future(self._grow())
+
+    async def _grow(self):
+        try:
+            proc = await self._spawn_worker(self._take_id())
+        finally:
+            self._spawning -= 1
+        if proc:
+            self._add(proc)
+        elif not self._workers and not self._spawning:
+            # 没有任何可用进程，排队请求不再可能被满足
+            while self._waiters:
+                _, fut = self._waiters.popleft()
+                if not fut.done():
+                    fut.set_exception(RuntimeError("没有可用的工作进程"))
+
+    def _maybe_grow(self):
+        """排队请求多于正在启动的进程时扩容，总数不超过 max_size；并补足 min_size"""
+        pending = sum(1 for _, fut in self._waiters if not fut.done())
+        while (pending > self._spawning
+               and self.size + self._spawning < self.max_size):
+            self._schedule_spawn()
+        while self.size + self._spawning < self.min_size:
+            self._schedule_spawn()
+
+    def _take_idle(self, model_type: Optional[str]) -> Optional[PoolWorker]:
+        if not self._idle:
+            return None
+        if model_type:
+            for i, worker in enumerate(self._idle):
+                if worker.model_type == model_type:
+                    return self._idle.pop(i)
+        # 无亲和命中：优先使用尚未绑定模型类型的进程，保留其他进程的热缓存
+        for i, worker in enumerate(self._idle):
+            if worker.model_type is None:
+                return self._idle.pop(i)
+        return self._idle.pop(0)
+
+    async def _acquire(self, model_type: Optional[str]) -> PoolWorker:
+        enqueued = time.monotonic()
+        worker = self._take_idle(model_type)
+        if worker is None:
+            fut = asyncio.get_running_loop().create_future()
+            entry = (model_type, fut)
+            self._waiters.append(entry)
+            self._maybe_grow()
+            try:
+                worker = await fut
+            except asyncio.CancelledError:
+                if fut.done() and not fut.cancelled():
+                    self._release(fut.result())
+                else:
+                    try:
+                        self._waiters.remove(entry)
+                    except ValueError:
+                        pass
+                raise
+
+        now = time.monotonic()
+        self._queue_waits.append(now - enqueued)
+        metrics.observe("queue_wait", now - enqueued)
+        worker.busy_since = now
+        if model_type and worker.model_type == model_type:
+            worker.affinity_hits += 1
+        return worker
+
+    def _release(self, worker: PoolWorker):
+        """归还进程：优先交给同模型类型的排队请求，否则交给队首请求或放回空闲列表"""
+        now = time.monotonic()
+        if worker.busy_since is not None:
+            worker.busy_seconds += now - worker.busy_since
+            worker.busy_since = None
+
+        while self._waiters and self._waiters[0][1].done():
+            self._waiters.popleft()  # 已取消的请求
+        if self._waiters:
+            # 亲和匹配只在队首窗口内查找，避免其他模型类型的请求饿死
+            chosen = 0
+            for i in range(min(len(self._waiters), AFFINITY_WINDOW)):
+                model_type, fut = self._waiters[i]
+                if not fut.done() and model_type and model_type == worker.model_type:
+                    chosen = i
+                    break
+            _, fut = self._waiters[chosen]
+            del self._waiters[chosen]
+            fut.set_result(worker)
+            return
+
+        worker.idle_since = now
+        self._idle.append(worker)
+
+    async def _discard(self, worker: PoolWorker):
+        if worker in self._workers:
+            self._workers.remove(worker)
+        if worker in self._idle:
+            self._idle.remove(worker)
+        await self._stop(worker)
+
+    async def _reap_idle(self):
+        """定期回收空闲超时的多余进程"""
+        while True:
+            await asyncio.sleep(POOL_REAP_INTERVAL)
+            now = time.monotonic()
+            for worker in list(self._idle):
+                if self.size <= self.min_size:
+                    break
+                if now - worker.idle_since > self.idle_timeout:
+                    logger.info(f"回收空闲工作进程 PID {worker.pid}")
+                    await self._discard(worker)
+
     async def _spawn_worker(self, worker_id: int = 0):
-        """启动一个工作进程并等待其发出 READY 信号"""
+        """启动一个工作进程并等待其发出 READY 帧"""
         proc = await asyncio.create_subprocess_exec(
             sys.executable, POOL_WORKER_SCRIPT,
             stdin=asyncio.subprocess.PIPE,
@@ -97,135 +462,375 @@ class WorkerPool:
             stderr=asyncio.subprocess.PIPE,
             env=_WORKER_ENV
         )
+        # stdout 仅承载协议帧，脚本输出经 stderr 转发到日志，避免管道写满阻塞
+        asyncio.ensure_future(self._drain_stderr(proc))
+        spawned = time.perf_counter()
         
         try:
             # 等待 READY 信号（最多等 30 秒）
-            line = await asyncio.wait_for(proc.stdout.readline(), timeout=30.0)
-            if b"READY" in line:
+            header, _ = await asyncio.wait_for(read_frame_async(proc.stdout), timeout=30.0)
+            if header.get("status") == "READY":
+                metrics.observe("warmup", time.perf_counter() - spawned)
                 logger.info(f"工作进程 #{worker_id} (PID {proc.pid}) 预热完成")
                 return proc
             else:
-                logger.warning(f"工作进程 #{worker_id} 返回异常信号: {line}")
+                logger.warning(f"工作进程 #{worker_id} 返回异常信号: {header}")
                 proc.kill()
                 return None
-        except asyncio.TimeoutError:
-            logger.warning(f"工作进程 #{worker_id} 预热超时")
+        except (asyncio.TimeoutError, asyncio.IncompleteReadError) as e:
+            logger.warning(f"工作进程 #{worker_id} 预热失败: {e!r}")
             proc.kill()
             return None
+
+    async def _drain_stderr(self, proc):
+        """转发工作进程的 stderr（脚本 print、OCCT 输出、导入告警）"""
+        while True:
+            try:
+                line = await proc.stderr.readline()
+            except ValueError:
+                continue  # 超长行已被丢弃
+            if not line:
+                break
+            logger.info(f"[worker {proc.pid}] {line.decode('utf-8', errors='replace').rstrip()}")
     
-    async def execute(self, code_file: str, args_file: str, output_path: str) -> tuple[bool, dict]:
-        """向空闲工作进程分发一个任务"""
-        logger.info(f"等待空闲工作进程... (当前队列大小: {self.available.qsize()})")
-        worker = await self.available.get()
+    async def _send_task(self, worker, task: dict, code: bytes = b"") -> tuple[dict, bytes]:
+        """发送一帧任务并读取一帧结果"""
+        worker.stdin.write(pack_frame(task, code))
+        await worker.stdin.drain()
+
+        # 等待结果（最多 120 秒）
+        return await asyncio.wait_for(read_frame_async(worker.stdout), timeout=120.0)
+
+    async def execute(self, code: str, code_hash: str, args: dict, fmt: str,
+                      output_path: Optional[str] = None,
+                      model_type: Optional[str] = None) -> WorkerResult:
+        """
+        向空闲工作进程分发一个任务。
+        模型默认随结果帧内联返回；指定 output_path 时由工作进程直接写入该文件。
+        """
+        logger.info(f"等待空闲工作进程... (排队: {len(self._waiters)}, 空闲: {len(self._idle)}/{self.size})")
+        worker = await self._acquire(model_type)
         logger.info(f"获取工作进程 PID {worker.pid}")
-        updated_args = {}
         
         try:
             # 检查进程是否还活着
-            if worker.returncode is not None:
+            if worker.proc.returncode is not None:
                 raise RuntimeError("工作进程已退出")
             
-            task = json.dumps({
-                "code_file": code_file,
-                "args_file": args_file,
-                "output_path": output_path
-            })
-            worker.stdin.write((task + "\n").encode())
-            await worker.stdin.drain()
-            
-            # 等待结果（最多 120 秒）
-            line = await asyncio.wait_for(worker.stdout.readline(), timeout=120.0)
-            try:
-                result = line.decode('utf-8').strip()
-            except UnicodeDecodeError:
-                result = line.decode('gbk', errors='ignore').strip()
-            
-            if result == "OK":
-                await self.available.put(worker)
-                logger.info(f"工作进程 PID {worker.pid} 任务完成 (OK)")
-                # 尝试读取导出的参数
-                out_args_path = args_file + ".out"
-                if os.path.exists(out_args_path):
-                    try:
-                        with open(out_args_path, "r", encoding="utf-8") as f:
-                            updated_args = json.load(f)
-                        os.remove(out_args_path)
-                    except Exception as e:
-                        logger.warning(f"读取导出的参数失败: {e}")
-                return True, updated_args
-            elif result == "ERR":
-                await self.available.put(worker)
-                logger.info(f"工作进程 PID {worker.pid} 任务失败 (ERR)")
-                return False, {}
-            else:
+            task = {
+                "op": "run",
+                "code_hash": code_hash,
+                "args": args,
+                "format": fmt
+            }
+            if output_path:
+                task["output_path"] = output_path
+            # 工作进程已缓存该脚本的编译结果时只发送哈希
+            source = b"" if code_hash in worker.scripts else code.encode("utf-8")
+            sent = time.perf_counter()
+            reply, body = await self._send_task(worker.proc, task, source)
+
+            if reply.get("status") == "MISS":
+                # 工作进程的 LRU 已淘汰该脚本，附带源码重试一次
+                worker.scripts.discard(code_hash)
+                sent = time.perf_counter()
+                reply, body = await self._send_task(worker.proc, task, code.encode("utf-8"))
+            round_trip = time.perf_counter() - sent
+
+            status = reply.get("status")
+            if status not in ("OK", "ERR"):
                 # 异常输出，进程可能已损坏
-                raise RuntimeError(f"工作进程异常输出: {result}")
-                
+                raise RuntimeError(f"工作进程异常输出: {reply}")
+
+            worker.scripts.add(code_hash)
+            worker.model_type = model_type
+            worker.tasks += 1
+            self._release(worker)
+            logger.info(f"工作进程 PID {worker.pid} 任务完成 ({status})")
+            if status == "OK":
+                timing = reply.get("timing", {})
+                if timing:
+                    metrics.observe("exec", timing.get("exec", 0.0))
+                    metrics.observe("export", timing.get("export", 0.0))
+                    metrics.observe("ipc", round_trip - timing.get("exec", 0.0)
+                                    - timing.get("export", 0.0))
+                cache = reply.get("cache", {})
+                worker.geometry_cache = cache.get("worker", worker.geometry_cache)
+                return WorkerResult(True, reply.get("args", {}), body,
+                                    cache={"hits": cache.get("hits", 0),
+                                           "misses": cache.get("misses", 0)})
+            return WorkerResult(False, error=reply.get("error", ""))
+
+        except asyncio.CancelledError:
+            # 请求被取消时结果帧可能仍在管道中，该进程的帧流已不可信
+            await self._discard(worker)
+            self._maybe_grow()
+            raise
         except Exception as e:
-            logger.warning(f"工作进程 PID {worker.pid} 异常: {e}，正在替换...")
+            logger.warning(f"工作进程 PID {worker.pid} 异常: {e!r}，正在替换...")
+            await self._discard(worker)
+            # 补足最小进程数，并为排队请求扩容
+            self._maybe_grow()
+            raise RuntimeError(f"工作进程异常: {e!r}")
+
+    def gauges(self) -> Dict[str, Any]:
+        """进程池实时状态"""
+        return {
+            "size": self.size,
+            "minSize": self.min_size,
+            "maxSize": self.max_size,
+            "idle": len(self._idle),
+            "busy": sum(1 for w in self._workers if w.busy_since is not None),
+            "spawning": self._spawning,
+            "queueDepth": sum(1 for _, fut in self._waiters if not fut.done())
+        }
+
+    def stats(self) -> Dict[str, Any]:
+        """各进程利用率与排队等待时间，用于调优批量生成"""
+        now = time.monotonic()
+        waits = sorted(self._queue_waits)
+
+        def percentile(p: float) -> float:
+            if not waits:
+                return 0.0
+            return round(waits[min(len(waits) - 1, int(p * len(waits)))] * 1000.0, 2)
+
+        workers = []
+        for worker in self._workers:
+            busy = worker.busy_seconds
+            if worker.busy_since is not None:
+                busy += now - worker.busy_since
+            uptime = now - worker.started_at
+            workers.append({
+                "pid": worker.pid,
+                "busy": worker.busy_since is not None,
+                "modelType": worker.model_type,
+                "tasks": worker.tasks,
+                "affinityHits": worker.affinity_hits,
+                "geometryCache": worker.geometry_cache,
+                "utilisation": round(busy / uptime, 3) if uptime > 0 else 0.0,
+                "uptimeSeconds": round(uptime, 1)
+            })
+
+        return {
+            **self.gauges(),
+            "queueWait": {
+                "samples": len(waits),
+                "meanMs": round(sum(waits) / len(waits) * 1000.0, 2) if waits else 0.0,
+                "p50Ms": percentile(0.5),
+                "p95Ms": percentile(0.95),
+                "maxMs": round(waits[-1] * 1000.0, 2) if waits else 0.0
+            },
+            "workers": workers
+        }
+
+    async def _stop(self, worker: PoolWorker):
+        proc = worker.proc
+        try:
+            if proc.returncode is None:
+                proc.stdin.write(pack_frame({"op": "exit"}))
+                await proc.stdin.drain()
+                await asyncio.wait_for(proc.wait(), timeout=5.0)
+        except Exception:
             try:
-                worker.kill()
+                proc.kill()
             except Exception:
                 pass
-            
-            # 启动替换进程
-            replacement = await self._spawn_worker()
-            if replacement:
-                await self.available.put(replacement)
-            
-            return False, {}
     
     async def shutdown(self):
         """关闭所有工作进程"""
-        for worker in self._all_workers:
-            try:
-                if worker.returncode is None:
-                    worker.stdin.write(b"EXIT\n")
-                    await worker.stdin.drain()
-                    await asyncio.wait_for(worker.wait(), timeout=5.0)
-            except Exception:
-                try:
-                    worker.kill()
-                except Exception:
-                    pass
+        if self._warmup and not self._warmup.done():
+            self._warmup.cancel()
+        if self._reaper:
+            self._reaper.cancel()
+        workers, self._workers, self._idle = self._workers, [], []
+        for worker in workers:
+            await self._stop(worker)
 
 
 # 全局工作进程池
-worker_pool = WorkerPool(POOL_SIZE)
+worker_pool = WorkerPool()
 
 # 加载 Schema 定义 (如果有 YAML 库用 YAML，这里暂时先预留加载逻辑)
-MODELS_SCHEMA = {}
 SCHEMA_FILE = os.path.join(os.path.dirname(__file__), "models_schema.yaml")
+SCHEMA_CHECK_INTERVAL = 1.0 # 检查 schema 文件 mtime 的最小间隔（秒）
+
+
+def build_ordered_schema(model_type: Optional[str], raw_schema: Dict[str, Any]) -> Dict[str, Any]:
+    """将 YAML 中的字段字典转换为带 name 与有序 fields 列表的 schema"""
+    ordered_schema = {}
+    if raw_schema:
+        # 提取构件显示名称
+        ordered_schema["name"] = raw_schema.get("name", model_type)
+        # 将字段字典转换为有序列表处理
+        fields_list = []
+        for key, info in raw_schema.items():
+            if key == "name" or not isinstance(info, dict):
+                continue
+            field_data = info.copy()
+            field_data["key"] = key
+            fields_list.append(field_data)
+        ordered_schema["fields"] = fields_list
+    return ordered_schema
 
-def load_schemas():
-    global MODELS_SCHEMA
-    if not os.path.exists(SCHEMA_FILE):
-        return
-    try:
-        # 如果没有 yaml 库，我们尝试探测它
-        import yaml
-        with open(SCHEMA_FILE, "r", encoding="utf-8") as f:
-            MODELS_SCHEMA = yaml.safe_load(f)
-    except ImportError:
-        logger.warning("未找到 PyYAML 库，Schema 渲染可能受限。建议安装: pip install PyYAML")
-        # 极简解析器，仅支持简单键值对 (fallback)
-        pass
-    except Exception as e:
-        logger.error(f"加载 Schema 失败: {e}")
 
-load_schemas()
+def schema_id(model_type: str, ordered_schema: Dict[str, Any]) -> str:
+    """schema 标识：模型类型 + 内容摘要，schema 变化后客户端缓存自然失效"""
+    canonical = json.dumps(ordered_schema, ensure_ascii=False, sort_keys=True)
+    digest = hashlib.sha256(canonical.encode("utf-8")).hexdigest()[:12]
+    return f"{model_type}@{digest}"
+
+
+class SchemaEntry(NamedTuple):
+    id: str
+    ordered: Dict[str, Any]
+    json: str   # 预序列化的有序 schema，直接拼入 JSON 头部
+
+
+class SchemaStore:
+    """
+    models_schema.yaml 的解析缓存。
+    仅在文件 mtime 变化时重新解析，同时预先生成有序 schema、schemaId，
+    以及 /api/v1/schemas 两种格式的响应正文，请求热路径上不再解析 YAML。
+    """
+
+    def __init__(self, path: str):
+        self.path = path
+        self.raw: Dict[str, Any] = {}
+        self.raw_json = b"{}"
+        self.ordered_json = b"{}"
+        self._entries: Dict[str, SchemaEntry] = {}
+        self._mtime = None
+        self._checked_at = 0.0
+
+    def refresh(self):
+        now = time.monotonic()
+        if now - self._checked_at < SCHEMA_CHECK_INTERVAL:
+            return
+        self._checked_at = now
+        try:
+            mtime = os.stat(self.path).st_mtime_ns
+        except OSError:
+            return
+        if mtime == self._mtime:
+            return
+        # 解析失败（如文件正在编辑）时保留旧 schema，文件再次变化后重试
+        self._mtime = mtime
+        try:
+            # 如果没有 yaml 库，我们尝试探测它
+            import yaml
+            with open(self.path, "r", encoding="utf-8") as f:
+                raw = yaml.safe_load(f) or {}
+        except ImportError:
+            logger.warning("未找到 PyYAML 库，Schema 渲染可能受限。建议安装: pip install PyYAML")
+            return
+        except Exception as e:
+            logger.error(f"加载 Schema 失败: {e}")
+            return
+        self._rebuild(raw)
+        logger.info(f"已加载 Schema: {len(self._entries)} 个模型")
+
+    def _rebuild(self, raw: Dict[str, Any]):
+        entries = {}
+        ordered_response = {}
+        for model_type, raw_schema in raw.items():
+            if not isinstance(raw_schema, dict):
+                continue
+            ordered = build_ordered_schema(model_type, raw_schema)
+            entry = SchemaEntry(schema_id(model_type, ordered), ordered,
+                                json.dumps(ordered, ensure_ascii=False))
+            entries[model_type] = entry
+            ordered_response[model_type] = {"id": entry.id, "schema": ordered}
+        self.raw = raw
+        self._entries = entries
+        self.raw_json = json.dumps(raw, ensure_ascii=False).encode("utf-8")
+        self.ordered_json = json.dumps(ordered_response, ensure_ascii=False).encode("utf-8")
+
+    def get(self, model_type: Optional[str]) -> Optional[SchemaEntry]:
+        return self._entries.get(model_type) if model_type else None
+
+
+schema_store = SchemaStore(SCHEMA_FILE)
+schema_store.refresh()
 
 
 @app.on_event("startup")
 async def startup_event():
-    """服务启动时预热工作进程池"""
-    await worker_pool.start()
+    """服务启动时在后台预热工作进程池，不阻塞监听端口"""
+    worker_pool.start_background()
+
+
+def encode_json_header(metadata: Dict[str, Any], schema_json: Optional[str]) -> bytes:
+    """序列化 JSON 头部；schema 使用预序列化文本拼接，不再逐请求序列化"""
+    text = json.dumps(metadata, ensure_ascii=False)
+    if schema_json is not None:
+        separator = ", " if metadata else ""
+        text = f'{text[:-1]}{separator}"schema": {schema_json}}}'
+    return text.encode("utf-8")
+
+
+def sweep_handoff_dir():
+    """删除客户端未取走的过期交付文件"""
+    deadline = time.time() - HANDOFF_TTL
+    try:
+        entries = list(os.scandir(HANDOFF_DIR))
+    except OSError:
+        return
+    for entry in entries:
+        try:
+            if entry.is_file() and entry.stat().st_mtime < deadline:
+                os.remove(entry.path)
+        except OSError:
+            pass
+
+
+def _cbor_head(major: int, value: int) -> bytes:
+    if value < 24:
+        return bytes([(major << 5) | value])
+    if value < 0x100:
+        return struct.pack(">BB", (major << 5) | 24, value)
+    if value < 0x10000:
+        return struct.pack(">BH", (major << 5) | 25, value)
+    if value < 0x100000000:
+        return struct.pack(">BI", (major << 5) | 26, value)
+    return struct.pack(">BQ", (major << 5) | 27, value)
+
+
+def cbor_encode(obj: Any) -> bytes:
+    """最小 CBOR (RFC 8949) 编码器，覆盖 JHB 头部用到的 JSON 兼容类型"""
+    if obj is None:
+        return b"\xf6"
+    if obj is True:
+        return b"\xf5"
+    if obj is False:
+        return b"\xf4"
+    if isinstance(obj, int):
+        return _cbor_head(0, obj) if obj >= 0 else _cbor_head(1, -1 - obj)
+    if isinstance(obj, float):
+        return b"\xfb" + struct.pack(">d", obj)
+    if isinstance(obj, str):
+        data = obj.encode("utf-8")
+        return _cbor_head(3, len(data)) + data
+    if isinstance(obj, (bytes, bytearray)):
+        return _cbor_head(2, len(obj)) + bytes(obj)
+    if isinstance(obj, (list, tuple)):
+        return _cbor_head(4, len(obj)) + b"".join(cbor_encode(v) for v in obj)
+    if isinstance(obj, dict):
+        return _cbor_head(5, len(obj)) + b"".join(
+            cbor_encode(str(k)) + cbor_encode(v) for k, v in obj.items())
+    return cbor_encode(str(obj))
+
 
 @app.get("/api/v1/schemas")
-async def get_schemas():
-    """获取所有模型的 Schema 定义"""
-    load_schemas()
-    return MODELS_SCHEMA
+async def get_schemas(format: str = "raw"):
+    """
+    获取所有模型的 Schema 定义。
+    format=ordered 时返回 {模型: {"id": schemaId, "schema": 有序 schema}}，
+    供使用 CBOR 头部的客户端按 schemaId 缓存。
+    """
+    schema_store.refresh()
+    body = schema_store.ordered_json if format == "ordered" else schema_store.raw_json
+    return Response(content=body, media_type="application/json")
 
 
 @app.on_event("shutdown") 
@@ -234,24 +839,77 @@ async def shutdown_event():
     await worker_pool.shutdown()
 
 
+@app.get("/api/v1/pool")
+async def get_pool_stats():
+    """工作进程池状态：进程数、排队深度、排队等待时间与各进程利用率"""
+    return worker_pool.stats()
+
+
+@app.get("/api/v1/ready")
+async def get_ready():
+    """
+    就绪检查：首批工作进程预热完成后返回 200，预热中（或没有可用进程）返回 503。
+    客户端启动时据此轮询，并借此建立 keep-alive 连接。
+    """
+    state = worker_pool.readiness()
+    state["schemaCount"] = len(schema_store.raw)
+    return Response(content=json.dumps(state), media_type="application/json",
+                    status_code=200 if state["ready"] else 503)
+
+
+@app.get("/api/v1/metrics")
+async def get_metrics():
+    """各阶段耗时直方图（预热/排队/执行/导出/管道/封装/总计）与进程池实时指标"""
+    return metrics.snapshot(worker_pool.gauges())
+
+
 @app.post("/api/v1/model/generate")
-async def generate_model(request: ScriptRequest):
-    load_schemas() # 调试期间确保 Schema 始终最新
+async def generate_model(request: ScriptRequest, http_request: Request):
+    started = time.perf_counter()
+    metrics.requests += 1
+    metrics.in_flight += 1
+    try:
+        return await _generate_model(request, http_request)
+    except Exception:
+        metrics.failed += 1
+        raise
+    finally:
+        metrics.in_flight -= 1
+        metrics.observe("total", time.perf_counter() - started)
+
+
+async def _generate_model(request: ScriptRequest, http_request: Request):
+    schema_store.refresh() # 调试期间确保 Schema 始终最新（仅在文件变化时重新解析）
     task_id = str(uuid.uuid4())
     
     # 根据请求指定格式（默认 step）
     ext = (request.format or "step").lower()
     if ext not in ["step", "brep", "iges", "stl"]:
         ext = "step"
-        
-    output_path = os.path.join(WORKSPACE, f"{task_id}.{ext}")
+
+    # 仅对本机客户端启用文件映射交付，远程客户端始终走 HTTP 正文
+    client_host = http_request.client.host if http_request.client else ""
+    local_transport = request.transport == "local" and client_host in LOOPBACK_HOSTS
+    # 默认模型随管道帧内联返回，仅在需要文件时由工作进程直接写盘
+    output_path = None
+    if local_transport:
+        sweep_handoff_dir()
+        output_path = os.path.join(HANDOFF_DIR, f"{task_id}.{ext}")
+    elif request.artifact:
+        output_path = os.path.join(WORKSPACE, f"{task_id}.{ext}")
     logger.info(f"生成任务 {task_id}: 格式={ext}, 模型类型={request.model_type}")
     
-    code_file = os.path.join(WORKSPACE, f"{task_id}_code.py")
-    args_file = os.path.join(WORKSPACE, f"{task_id}_args.json")
-    
     try:
-        code = request.code
+        code = request.code or ""
+        code_hash = request.code_hash
+        if code:
+            code_hash = script_cache.put(code)
+        elif code_hash:
+            # 客户端只发送了哈希：从缓存补全脚本，未命中时要求客户端补传全文
+            code = script_cache.get(code_hash)
+            if code is None:
+                raise HTTPException(status_code=409,
+                                    detail={"error": "script_miss", "code_hash": code_hash})
         # 如果代码为空但提供了模型类型，则尝试读取同名脚本文件
         if not code and request.model_type:
             script_path = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "cq_script", f"{request.model_type}.py"))
@@ -264,74 +922,83 @@ async def generate_model(request: ScriptRequest):
                         code = sf.read()
             else:
                 raise HTTPException(status_code=400, detail=f"未找到脚本: {script_path}")
+            code_hash = script_cache.put(code)
+        if not code:
+            raise HTTPException(status_code=400, detail="请求中没有可执行的脚本")
         
-        with open(code_file, "w", encoding="utf-8") as f:
-            f.write(code)
-        with open(args_file, "w", encoding="utf-8") as f:
-            json.dump(request.args, f)
-        
-        # 分发到预热的工作进程池（非阻塞）
-        success, updated_args = await worker_pool.execute(code_file, args_file, output_path)
-        
-        # 使用更新后的参数（包含脚本计算出的结果）进行返回
-        effective_args = request.args.copy()
-        effective_args.update(updated_args)
+        # 分发到预热的工作进程池（非阻塞），脚本源码仅在工作进程未缓存时随帧发送
+        result = await worker_pool.execute(code, code_hash, request.args, ext, output_path,
+                                           model_type=request.model_type)
+    except HTTPException:
+        raise
     except Exception as e:
         raise HTTPException(status_code=500, detail=str(e))
-    finally:
-        # 清理临时文件
-        for f in [code_file, args_file]:
-            if os.path.exists(f):
-                os.remove(f)
-        
-    error_file = output_path + ".err"
-    if os.path.exists(error_file):
-        with open(error_file, "r", encoding="utf-8") as f:
-            err_msg = f.read()
-        raise HTTPException(status_code=400, detail=f"脚本错误:\n{err_msg}")
 
-    if not os.path.exists(output_path):
+    if not result.success:
+        raise HTTPException(status_code=400, detail=f"脚本错误:\n{result.error}")
+
+    if output_path and not os.path.exists(output_path):
         raise HTTPException(status_code=500, detail="脚本执行结束但未生成任何输出文件。")
 
+    # 使用更新后的参数（包含脚本计算出的结果）进行返回
+    effective_args = request.args.copy()
+    effective_args.update(result.args)
+
     # JHB (JSON-Header + Binary-Body) 封装
+    package_started = time.perf_counter()
     # 构造元数据
-    raw_schema = MODELS_SCHEMA.get(request.model_type, {}) if request.model_type else {}
-    ordered_schema = {}
-    if raw_schema:
-        # 提取构件显示名称
-        ordered_schema["name"] = raw_schema.get("name", request.model_type)
-        # 将字段字典转换为有序列表处理
-        fields_list = []
-        for key, info in raw_schema.items():
-            if key == "name" or not isinstance(info, dict):
-                continue
-            field_data = info.copy()
-            field_data["key"] = key
-            fields_list.append(field_data)
-        ordered_schema["fields"] = fields_list
+    schema = schema_store.get(request.model_type)
 
+    # schema 在序列化头部时追加（JSON 拼接预序列化文本，CBOR 只携带 schemaId）
     metadata = {
         "args": effective_args,
         "modelType": request.model_type,
-        "name": ordered_schema.get("name", request.model_type),
-        "schema": ordered_schema
+        "name": schema.ordered.get("name", request.model_type) if schema else request.model_type
     }
+    if result.cache:
+        metadata["geometryCache"] = result.cache
     
     try:
-        json_bytes = json.dumps(metadata, ensure_ascii=False).encode("utf-8")
-        
-        with open(output_path, "rb") as f:
-            brep_bytes = f.read()
-            
-        # 格式: [4字节长度 L][L字节 JSON][原始 BREP]
+        if local_transport:
+            # 正文留在交付文件中，由客户端映射后直接解析
+            metadata["localBody"] = {"path": output_path,
+                                     "size": os.path.getsize(output_path)}
+            brep_bytes = b""
+            body_encoding = "identity"
+        else:
+            # 正文编码写入头部，客户端在解析头部后即可选择解压方式
+            body_encoding = negotiate_body_encoding(request.accept_encoding)
+            # 读取与压缩多 MB 的 B-rep 放到线程中，不阻塞事件循环上的其他请求
+            body_size, brep_bytes = await asyncio.to_thread(
+                load_body, output_path, result.geometry, body_encoding,
+                request.compression_level)
+            if body_encoding != "identity":
+                metadata["bodyEncoding"] = body_encoding
+                metadata["bodySize"] = body_size
+
+        if request.header_format == "cbor":
+            # CBOR 头部只携带 schemaId，schema 正文由客户端从 /api/v1/schemas 缓存
+            if schema:
+                metadata["schemaId"] = schema.id
+            else:
+                metadata["schema"] = {}
+            header_bytes = cbor_encode(metadata)
+        else:
+            header_bytes = encode_json_header(metadata, schema.json if schema else "{}")
+
+        # 格式: [4字节长度 L][L字节 JSON 或 CBOR 头部][原始 BREP]
         # 使用小端序 (Little-endian) 以匹配 Windows/Qt 环境
-        header = struct.pack("<I", len(json_bytes))
-        full_package = header + json_bytes + brep_bytes
+        header = struct.pack("<I", len(header_bytes))
+        full_package = header + header_bytes + brep_bytes
+        metrics.observe("package", time.perf_counter() - package_started)
         
         return Response(
             content=full_package,
             media_type="application/octet-stream",
-            headers={"Content-Disposition": f"attachment; filename={task_id}.jhb"}
+            headers={
+                "Content-Disposition": f"attachment; filename={task_id}.jhb",
+                "X-JHB-Body-Encoding": body_encoding
+            }
         )
     except Exception as e:
         raise HTTPException(status_code=500, detail=f"封装 JHB 失败: {e}")
@@ -350,5 +1017,11 @@ async def download_model(task_id: str, ext: str = "step"):
 app.mount("/", StaticFiles(directory=WEB_DIR, html=True), name="web")
 
 if __name__ == "__main__":
-    import uvicorn 
-    uvicorn.run(app, host="127.0.0.1", port=8000)
+    import argparse
+    import uvicorn
+    # 同机可启动多个实例（不同端口），客户端通过 QTOCCT_SERVICE_ENDPOINTS 分摊批量任务
+    parser = argparse.ArgumentParser(description="OCCT 建模微服务")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=int(os.environ.get("OCCT_SERVICE_PORT", "8000")))
+    opts = parser.parse_args()
+    uvicorn.run(app, host=opts.host, port=opts.port)
@@ -1,20 +1,167 @@
 ﻿"""
 常驻工作进程：启动时预导入 cadquery（耗时约1-2秒），
 之后通过 stdin/stdout 管道持续接收多个建模任务，避免重复导入开销。
+脚本、参数、结果模型与错误信息均以帧的形式经管道传输（见 worker_protocol.py），
+仅在主进程指定 output_path（可下载产物 / 同机交付）时才写磁盘。
 """
 import sys
-import json
-import traceback
+import io
 import os
+import tempfile
+import time
+import traceback
+from collections import OrderedDict
+
+from worker_protocol import pack_frame, read_frame
+
+# stdout 专用于协议帧：保留原 fd 1 作为帧输出，
+# 之后脚本的 print 与 OCCT 的原生输出都重定向到 stderr，不会破坏帧流
+_frame_out = os.fdopen(os.dup(sys.stdout.fileno()), "wb")
+os.dup2(sys.stderr.fileno(), sys.stdout.fileno())
+sys.stdout = sys.stderr
+_frame_in = sys.stdin.buffer
 
 # ====== 预热阶段：一次性导入所有重量级依赖 ======
 import cadquery as cq
 from OCP.TopoDS import TopoDS_Shape
 from OCP.BRepTools import BRepTools
 
-def execute_task(code, args, output_path, args_file=None):
-    """在当前进程中执行 CadQuery 脚本并导出 BREP"""
-    local_vars = {"cq": cq}
+# 已编译脚本缓存：code_hash -> code object，同一脚本只解析/编译一次
+CODE_CACHE_SIZE = 128
+_code_cache: "OrderedDict[str, object]" = OrderedDict()
+
+# 脚本几何记忆化缓存容量（条目数）
+GEOMETRY_CACHE_SIZE = int(os.environ.get("OCCT_GEOMETRY_CACHE_SIZE", 256))
+
+
+class GeometryCache:
+    """
+    脚本可用的几何记忆化缓存，以 `cache` 注入脚本命名空间：
+
+        pile = cache.get_or_build(("Pile.pile", diameter, length), build_pile)
+
+    key 必须可哈希且包含决定几何的全部参数；fn 无参数，返回 cq.Workplane、cq.Shape
+    或 TopoDS_Shape。缓存保存底层 TopoDS_Shape（OCCT 形状按引用共享），命中时按原类型
+    重新包装返回。布尔运算、平移等操作都会生成新形状，缓存内容不会被修改。
+    """
+
+    def __init__(self, capacity: int = GEOMETRY_CACHE_SIZE):
+        self.capacity = capacity
+        self.hits = 0
+        self.misses = 0
+        self._entries: "OrderedDict[object, tuple]" = OrderedDict()
+
+    def __len__(self):
+        return len(self._entries)
+
+    def get_or_build(self, key, fn):
+        entry = self._entries.get(key)
+        if entry is not None:
+            self._entries.move_to_end(key)
+            self.hits += 1
+            return self._wrap(*entry)
+
+        self.misses += 1
+        value = fn()
+        self._entries[key] = self._unwrap(value)
+        while len(self._entries) > self.capacity:
+            self._entries.popitem(last=False)
+        return value
+
+    @staticmethod
+    def _unwrap(value):
+        if isinstance(value, cq.Workplane):
+            shapes = [v for v in value.vals() if isinstance(v, cq.Shape)]
+            shape = shapes[0] if len(shapes) == 1 else cq.Compound.makeCompound(shapes)
+            return "workplane", shape.wrapped
+        if isinstance(value, cq.Shape):
+            return "shape", value.wrapped
+        return "raw", value
+
+    @staticmethod
+    def _wrap(kind, stored):
+        if kind == "workplane":
+            return cq.Workplane("XY", obj=cq.Shape.cast(stored))
+        if kind == "shape":
+            return cq.Shape.cast(stored)
+        return stored
+
+    def stats(self):
+        total = self.hits + self.misses
+        return {
+            "hits": self.hits,
+            "misses": self.misses,
+            "entries": len(self._entries),
+            "hitRate": round(self.hits / total, 3) if total else 0.0
+        }
+
+
+geometry_cache = GeometryCache()
+
+
+def send_frame(header, body=b""):
+    _frame_out.write(pack_frame(header, body))
+    _frame_out.flush()
+
+
+def get_compiled(code_hash, source):
+    """按哈希取出已编译脚本；未命中且没有附带源码时返回 None"""
+    if code_hash and code_hash in _code_cache:
+        _code_cache.move_to_end(code_hash)
+        return _code_cache[code_hash]
+    if not source:
+        return None
+
+    compiled = compile(source, f"<script {(code_hash or 'inline')[:12]}>", "exec")
+    if code_hash:
+        _code_cache[code_hash] = compiled
+        while len(_code_cache) > CODE_CACHE_SIZE:
+            _code_cache.popitem(last=False)
+    return compiled
+
+
+def to_shape(result):
+    """将脚本结果统一为 cq.Shape"""
+    if isinstance(result, cq.Assembly):
+        # Assemblies cannot be saved as BREP directly, convert to Compound
+        return result.toCompound()
+    if isinstance(result, cq.Workplane):
+        return cq.Compound.makeCompound(
+            [v for v in result.vals() if isinstance(v, cq.Shape)])
+    return result
+
+
+def export_result(result, ext, output_path=None):
+    """导出结果：指定 output_path 时写文件并返回空正文，否则返回模型字节"""
+    if output_path:
+        if isinstance(result, cq.Assembly) and ext != "BREP":
+            result.save(output_path, ext)
+        else:
+            cq.exporters.export(to_shape(result), output_path, ext)
+        return b""
+
+    if ext == "BREP":
+        buffer = io.BytesIO()
+        to_shape(result).exportBrep(buffer)
+        return buffer.getvalue()
+
+    # STEP/IGES/STL 导出器只接受文件路径，经临时文件中转
+    fd, temp_path = tempfile.mkstemp(suffix="." + ext.lower())
+    os.close(fd)
+    try:
+        export_result(result, ext, temp_path)
+        with open(temp_path, "rb") as f:
+            return f.read()
+    finally:
+        os.remove(temp_path)
+
+
+def execute_task(code, args, ext, output_path=None, timing=None):
+    """
+    在当前进程中执行 CadQuery 脚本，返回 (更新后的参数, 模型字节)。
+    timing 不为 None 时写入脚本执行 (exec) 与导出 (export) 耗时（秒）。
+    """
+    local_vars = {"cq": cq, "cache": geometry_cache}
     for k, v in args.items():
         if isinstance(v, str):
             v_stripped = v.strip()
@@ -26,70 +173,64 @@ def execute_task(code, args, output_path, args_file=None):
                 pass
         local_vars[k] = v
     
+    started = time.perf_counter()
     exec(code, local_vars, local_vars)
+    exec_seconds = time.perf_counter() - started
     
     # 提取脚本执行后的参数值（回传给前端）
-    if args_file:
-        updated_args = {}
-        # 收集所有基础类型的本地变量，包括脚本计算出的 out 参数
-        for k, v in local_vars.items():
-            if not k.startswith('_') and k != 'cq' and k != 'result' and k != 'shape_to_export':
-                if isinstance(v, (int, float, str, bool)):
-                    updated_args[k] = v
-        
-        with open(args_file + ".out", "w", encoding="utf-8") as f:
-             json.dump(updated_args, f, ensure_ascii=False)
+    updated_args = {}
+    # 收集所有基础类型的本地变量，包括脚本计算出的 out 参数
+    for k, v in local_vars.items():
+        if not k.startswith('_') and k not in ('cq', 'cache', 'result', 'shape_to_export'):
+            if isinstance(v, (int, float, str, bool)):
+                updated_args[k] = v
 
     if "result" not in local_vars:
         raise KeyError("脚本没有输出包含 'result' 变量")
     
-    result = local_vars["result"]
-    ext = os.path.splitext(output_path)[1].upper().replace(".", "")
+    ext = ext.upper()
     if ext not in ["STEP", "IGES", "BREP", "STL"]:
         ext = "STEP" # Default
-        
-    if isinstance(result, cq.Assembly):
-        if ext == "BREP":
-            # Assemblies cannot be saved as BREP directly, convert to Compound
-            cq.exporters.export(result.toCompound(), output_path, ext)
-        else:
-            result.save(output_path, ext)
-    else:
-        # Fallback for Workplane and other shapes
-        cq.exporters.export(result, output_path, ext)
+    started = time.perf_counter()
+    geometry = export_result(local_vars["result"], ext, output_path)
+    if timing is not None:
+        timing["exec"] = exec_seconds
+        timing["export"] = time.perf_counter() - started
+    return updated_args, geometry
 
 # 通知主进程：预热完毕，可以接收任务
-print("READY", flush=True)
+send_frame({"status": "READY", "pid": os.getpid()})
 
 # ====== 任务循环：持续等待并处理任务 ======
-for line in sys.stdin:
-    line = line.strip()
-    if not line:
-        continue
-    if line == "EXIT":
+while True:
+    try:
+        task, body = read_frame(_frame_in)
+    except EOFError:
+        break
+    if task.get("op") == "exit":
         break
     
     try:
-        task = json.loads(line)
-        code_file = task["code_file"]
-        args_file = task["args_file"]
-        output_path = task["output_path"]
-        
-        try:
-            with open(code_file, 'r', encoding='utf-8') as f:
-                code = f.read()
-        except UnicodeDecodeError:
-            with open(code_file, 'r', encoding='gbk') as f:
-                code = f.read()
-        with open(args_file, 'r', encoding='utf-8') as f:
-            args = json.load(f)
+        source = body.decode("utf-8") if body else None
+        code = get_compiled(task.get("code_hash"), source)
+        if code is None:
+            # 缓存已淘汰且主进程未附带源码，请求补发
+            send_frame({"status": "MISS"})
+            continue
         
-        execute_task(code, args, output_path, args_file)
-        print("OK", flush=True)
+        hits, misses = geometry_cache.hits, geometry_cache.misses
+        timing = {}
+        updated_args, geometry = execute_task(code, task.get("args", {}),
+                                              task.get("format", "step"),
+                                              task.get("output_path"), timing)
+        # 本次任务的几何缓存命中情况，以及该进程累计统计
+        cache_stats = {
+            "hits": geometry_cache.hits - hits,
+            "misses": geometry_cache.misses - misses,
+            "worker": geometry_cache.stats()
+        }
+        send_frame({"status": "OK", "args": updated_args, "cache": cache_stats,
+                    "timing": timing}, geometry)
         
     except Exception:
-        # 写入错误文件供主进程读取
-        err_path = task.get("output_path", "unknown") + ".err"
-        with open(err_path, "w", encoding="utf-8") as f:
-            f.write(traceback.format_exc())
-        print("ERR", flush=True)
+        send_frame({"status": "ERR", "error": traceback.format_exc()})
@@ -0,0 +1,51 @@
+"""
+主进程与常驻工作进程之间的管道帧协议。
+
+每帧格式（小端序）:
+    [4字节头部长度 H][H字节 JSON 头部][4字节正文长度 B][B字节正文]
+
+主进程 -> 工作进程:
+    {"op": "run", "code_hash", "args", "format", "output_path"?}  正文为脚本源码（工作进程已缓存时为空）
+    {"op": "exit"}
+工作进程 -> 主进程:
+    {"status": "READY", "pid"}                                   启动完成
+    {"status": "OK", "args", "cache", "timing"}                  正文为导出的模型（已写入 output_path 时为空）；
+                                                                 cache 为几何缓存命中统计，timing 为执行/导出耗时
+    {"status": "ERR", "error"}                                   脚本异常的 traceback
+    {"status": "MISS"}                                           脚本缓存已淘汰，请求补发源码
+"""
+import json
+import struct
+
+_LEN = struct.Struct("<I")
+
+
+def pack_frame(header: dict, body: bytes = b"") -> bytes:
+    header_bytes = json.dumps(header, ensure_ascii=False).encode("utf-8")
+    return b"".join((_LEN.pack(len(header_bytes)), header_bytes,
+                     _LEN.pack(len(body)), body))
+
+
+def _read_exact(stream, size: int) -> bytes:
+    data = stream.read(size)
+    if len(data) != size:
+        raise EOFError("管道已关闭")
+    return data
+
+
+def read_frame(stream):
+    """从阻塞式二进制流读取一帧，返回 (header, body)"""
+    header_len = _LEN.unpack(_read_exact(stream, 4))[0]
+    header = json.loads(_read_exact(stream, header_len).decode("utf-8"))
+    body_len = _LEN.unpack(_read_exact(stream, 4))[0]
+    body = _read_exact(stream, body_len) if body_len else b""
+    return header, body
+
+
+async def read_frame_async(reader):
+    """从 asyncio.StreamReader 读取一帧，返回 (header, body)"""
+    header_len = _LEN.unpack(await reader.readexactly(4))[0]
+    header = json.loads((await reader.readexactly(header_len)).decode("utf-8"))
+    body_len = _LEN.unpack(await reader.readexactly(4))[0]
+    body = await reader.readexactly(body_len) if body_len else b""
+    return header, body
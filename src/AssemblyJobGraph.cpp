@@ -0,0 +1,91 @@
+#include "../include/AssemblyJobGraph.h"
+
+#include <QJsonValue>
+
+void AssemblyJobGraph::clear() { m_jobs.clear(); }
+
+int AssemblyJobGraph::addJob(const QString &modelType,
+                             const QJsonObject &args) {
+  Job job;
+  job.modelType = modelType;
+  job.args = args;
+  m_jobs.append(job);
+  return m_jobs.size() - 1;
+}
+
+void AssemblyJobGraph::bind(int job, const QString &arg, int source,
+                            const QString &sourceArg) {
+  Q_ASSERT(source != job && source >= 0 && source < m_jobs.size());
+  m_jobs[job].bindings.append({arg, source, sourceArg});
+}
+
+QList<int> AssemblyJobGraph::takeReady() {
+  QList<int> ready;
+  for (int i = 0; i < m_jobs.size(); ++i) {
+    Job &job = m_jobs[i];
+    if (!job.dispatched && inputsResolved(job)) {
+      job.dispatched = true;
+      ready.append(i);
+    }
+  }
+  return ready;
+}
+
+void AssemblyJobGraph::resolveOutputs(int job, const QVariantMap &outputs) {
+  Job &entry = m_jobs[job];
+  if (entry.resolved)
+    return;
+  entry.outputs = outputs;
+  entry.resolved = true;
+}
+
+void AssemblyJobGraph::complete(int job, bool succeeded) {
+  Job &entry = m_jobs[job];
+  entry.resolved = true;
+  entry.completed = true;
+  entry.failed = !succeeded;
+}
+
+bool AssemblyJobGraph::isFinished() const {
+  for (const Job &job : m_jobs) {
+    if (!job.completed)
+      return false;
+  }
+  return true;
+}
+
+int AssemblyJobGraph::failedCount() const {
+  int count = 0;
+  for (const Job &job : m_jobs) {
+    if (job.failed)
+      ++count;
+  }
+  return count;
+}
+
+QJsonObject AssemblyJobGraph::inputArgs(int job) const {
+  const Job &entry = m_jobs[job];
+  QJsonObject args = entry.args;
+  for (const Binding &binding : entry.bindings) {
+    const QVariant value = m_jobs[binding.source].outputs.value(binding.sourceArg);
+    if (value.isValid()) {
+      args[binding.arg] = QJsonValue::fromVariant(value);
+    }
+  }
+  return args;
+}
+
+double AssemblyJobGraph::output(int job, const QString &arg,
+                                double fallback) const {
+  bool ok = false;
+  const double value = m_jobs[job].outputs.value(arg).toDouble(&ok);
+  return ok ? value : fallback;
+}
+
+bool AssemblyJobGraph::inputsResolved(const Job &job) const {
+  for (const Binding &binding : job.bindings) {
+    if (!m_jobs[binding.source].resolved)
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,466 @@
+#include "../include/JhbDecoder.h"
+#include "../include/MemoryStreamBuf.h"
+
+#include <BRepTools.hxx>
+#include <BRep_Builder.hxx>
+#include <Standard_Failure.hxx>
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+
+#ifdef QTOCCT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef QTOCCT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// 正文前缀达到该长度后判定格式（"ISO-10303-21" 为 STEP，其余按 B-rep 流式解析）
+static const int kFormatSniffBytes = 12;
+
+// 由网络数据块拼接而成的阻塞式输入流：后台解析线程在数据不足时等待新的块
+class JhbBodyStream : public std::streambuf {
+public:
+  void push(const QByteArray &chunk) {
+    if (chunk.isEmpty())
+      return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_readerDone)
+      return; // 解析已结束，丢弃多余数据
+    m_chunks.push_back(chunk);
+    m_cv.notify_one();
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_cv.notify_one();
+  }
+
+  void abort() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_chunks.clear();
+    m_cv.notify_one();
+  }
+
+  void markReaderDone() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_readerDone = true;
+    m_chunks.clear();
+  }
+
+protected:
+  int_type underflow() override {
+    if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]() { return !m_chunks.empty() || m_closed; });
+    if (m_chunks.empty())
+      return traits_type::eof();
+
+    m_current = m_chunks.front();
+    m_chunks.pop_front();
+    char *base = const_cast<char *>(m_current.constData());
+    setg(base, base, base + m_current.size());
+    return traits_type::to_int_type(*gptr());
+  }
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<QByteArray> m_chunks;
+  QByteArray m_current;
+  bool m_closed = false;
+  bool m_readerDone = false;
+};
+
+// 正文流式解压：每次输入一块压缩数据，追加输出已解压的部分
+class JhbInflater {
+public:
+  virtual ~JhbInflater() = default;
+  virtual bool decompress(const QByteArray &in, QByteArray &out) = 0;
+};
+
+#ifdef QTOCCT_HAVE_ZLIB
+class ZlibInflater : public JhbInflater {
+public:
+  ZlibInflater() { m_ok = inflateInit(&m_zs) == Z_OK; }
+  ~ZlibInflater() override { inflateEnd(&m_zs); }
+
+  bool decompress(const QByteArray &in, QByteArray &out) override {
+    if (!m_ok)
+      return false;
+    if (m_ended)
+      return true; // 流结束后的多余字节忽略
+    char buffer[64 * 1024];
+    m_zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.constData()));
+    m_zs.avail_in = static_cast<uInt>(in.size());
+    do {
+      m_zs.next_out = reinterpret_cast<Bytef *>(buffer);
+      m_zs.avail_out = sizeof(buffer);
+      int ret = inflate(&m_zs, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        m_ended = true;
+      } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return false;
+      }
+      out.append(buffer, static_cast<int>(sizeof(buffer) - m_zs.avail_out));
+    } while (m_zs.avail_out == 0 && !m_ended);
+    return true;
+  }
+
+private:
+  z_stream m_zs{};
+  bool m_ok = false;
+  bool m_ended = false;
+};
+#endif
+
+#ifdef QTOCCT_HAVE_ZSTD
+class ZstdInflater : public JhbInflater {
+public:
+  ZstdInflater() : m_stream(ZSTD_createDStream()) {
+    if (m_stream)
+      ZSTD_initDStream(m_stream);
+  }
+  ~ZstdInflater() override { ZSTD_freeDStream(m_stream); }
+
+  bool decompress(const QByteArray &in, QByteArray &out) override {
+    if (!m_stream)
+      return false;
+    char buffer[64 * 1024];
+    ZSTD_inBuffer input{in.constData(), static_cast<size_t>(in.size()), 0};
+    ZSTD_outBuffer output{buffer, sizeof(buffer), 0};
+    do {
+      output.pos = 0;
+      size_t ret = ZSTD_decompressStream(m_stream, &output, &input);
+      if (ZSTD_isError(ret))
+        return false;
+      out.append(buffer, static_cast<int>(output.pos));
+    } while (input.pos < input.size || output.pos == output.size);
+    return true;
+  }
+
+private:
+  ZSTD_DStream *m_stream;
+};
+#endif
+
+static std::unique_ptr<JhbInflater> createInflater(const QString &encoding) {
+#ifdef QTOCCT_HAVE_ZSTD
+  if (encoding == "zstd")
+    return std::make_unique<ZstdInflater>();
+#endif
+#ifdef QTOCCT_HAVE_ZLIB
+  if (encoding == "deflate")
+    return std::make_unique<ZlibInflater>();
+#endif
+  Q_UNUSED(encoding);
+  return nullptr;
+}
+
+QStringList JhbDecoder::supportedEncodings() {
+  QStringList encodings;
+#ifdef QTOCCT_HAVE_ZSTD
+  encodings << "zstd";
+#endif
+#ifdef QTOCCT_HAVE_ZLIB
+  encodings << "deflate";
+#endif
+  return encodings;
+}
+
+JhbDecoder::JhbDecoder(QObject *parent) : QObject(parent) {}
+
+JhbDecoder::~JhbDecoder() { abort(); }
+
+void JhbDecoder::feed(const QByteArray &chunk) {
+  if (chunk.isEmpty() || m_state == State::Done)
+    return;
+
+  if (m_state == State::Body) {
+    consumeBody(chunk);
+    return;
+  }
+
+  m_pending.append(chunk);
+
+  if (m_state == State::Length) {
+    if (m_pending.size() < 4)
+      return;
+    quint32 jsonLen = 0;
+    memcpy(&jsonLen, m_pending.constData(), 4); // 小端序
+    m_headerLength = jsonLen;
+    m_pending.remove(0, 4);
+    m_state = State::Header;
+  }
+
+  if (m_state == State::Header) {
+    if (static_cast<quint32>(m_pending.size()) < m_headerLength)
+      return;
+
+    QByteArray headerData = m_pending.left(m_headerLength);
+    QByteArray rest = m_pending.mid(m_headerLength);
+    m_pending.clear();
+
+    m_metadata = parseHeader(headerData);
+    m_state = State::Body;
+
+    const QString encoding = m_metadata.value("bodyEncoding").toString();
+    if (!encoding.isEmpty() && encoding != "identity") {
+      m_inflater = createInflater(encoding);
+      if (!m_inflater) {
+        fail(QString("不支持的正文编码: %1").arg(encoding));
+        return;
+      }
+    }
+    emit headerReady(m_metadata);
+
+    if (m_metadata.contains("localBody")) {
+      // 交付文件在响应发出前已写完，无需等待 HTTP 正文
+      startLocalParse();
+      return;
+    }
+    consumeBody(rest);
+  }
+}
+
+QVariantMap JhbDecoder::parseHeader(const QByteArray &data) {
+  // JSON 头部总以 '{' 开头；CBOR 映射的首字节为 0xA0-0xBF
+  if (!data.isEmpty() && data.at(0) == '{') {
+    return QJsonDocument::fromJson(data).object().toVariantMap();
+  }
+  return QCborValue::fromCbor(data).toMap().toVariantMap();
+}
+
+void JhbDecoder::consumeBody(const QByteArray &chunk) {
+  if (!m_inflater) {
+    consumePlainBody(chunk);
+    return;
+  }
+  QByteArray plain;
+  if (!m_inflater->decompress(chunk, plain)) {
+    fail("JHB 正文解压失败");
+    return;
+  }
+  consumePlainBody(plain);
+}
+
+void JhbDecoder::consumePlainBody(const QByteArray &chunk) {
+  if (chunk.isEmpty())
+    return;
+  switch (m_bodyMode) {
+  case BodyMode::Stream:
+    m_stream->push(chunk);
+    return;
+  case BodyMode::Buffer:
+    m_body.append(chunk);
+    return;
+  case BodyMode::Local:
+    return; // 正文在交付文件中
+  case BodyMode::Unknown:
+    break;
+  }
+
+  m_pending.append(chunk);
+  if (m_pending.size() >= kFormatSniffBytes)
+    selectBodyMode();
+}
+
+void JhbDecoder::selectBodyMode() {
+  if (m_pending.startsWith("ISO-10303-21")) {
+    m_bodyMode = BodyMode::Buffer;
+    m_body = m_pending;
+    m_pending.clear();
+  } else {
+    startStreaming();
+  }
+}
+
+void JhbDecoder::startStreaming() {
+  m_bodyMode = BodyMode::Stream;
+  m_stream = std::make_shared<JhbBodyStream>();
+  m_stream->push(m_pending);
+  m_pending.clear();
+
+  std::shared_ptr<JhbBodyStream> stream = m_stream;
+  JhbDecoder *self = this;
+  // 析构函数会先中止数据流并 join 线程，因此线程存续期间 self 始终有效
+  m_parser = std::thread([self, stream]() {
+    std::istream in(stream.get());
+    TopoDS_Shape shape;
+    BRep_Builder builder;
+    try {
+      BRepTools::Read(shape, in, builder);
+    } catch (const Standard_Failure &) {
+      shape.Nullify();
+    }
+    stream->markReaderDone();
+    QMetaObject::invokeMethod(
+        self, [self, shape]() { self->onParserFinished(shape); },
+        Qt::QueuedConnection);
+  });
+}
+
+// 交付文件的规范路径：必须位于交付目录内且文件名为服务端生成的 <uuid>.<ext>，
+// 否则返回空串（不可信的路径不打开也不删除）
+QString JhbDecoder::handoffFilePath(const QString &path) const {
+  static const QRegularExpression handoffName(
+      "^[0-9a-f]{8}-[0-9a-f]{4}-[0-9a-f]{4}-[0-9a-f]{4}-[0-9a-f]{12}"
+      "\\.[A-Za-z0-9]+$");
+  const QString dir = QDir(m_handoffDir).canonicalPath();
+  const QString file = QFileInfo(path).canonicalFilePath();
+  if (m_handoffDir.isEmpty() || dir.isEmpty() || file.isEmpty())
+    return QString();
+  const QFileInfo info(file);
+  if (info.absolutePath() != dir ||
+      !handoffName.match(info.fileName()).hasMatch())
+    return QString();
+  return file;
+}
+
+void JhbDecoder::startLocalParse() {
+  const QVariantMap local = m_metadata.value("localBody").toMap();
+  const qint64 size = local.value("size").toLongLong();
+  const QString path = handoffFilePath(local.value("path").toString());
+  if (path.isEmpty()) {
+    fail("本地交付文件不在交付目录中");
+    return;
+  }
+  m_localFile = std::make_unique<QFile>(path);
+  if (!m_localFile->open(QIODevice::ReadOnly) || m_localFile->size() < size) {
+    releaseLocalBody();
+    fail("无法打开本地交付文件");
+    return;
+  }
+
+  if (size == 0) {
+    m_bodyMode = BodyMode::Buffer;
+    releaseLocalBody();
+    return;
+  }
+  const uchar *mapped = m_localFile->map(0, size);
+  if (!mapped) {
+    releaseLocalBody();
+    fail("无法映射本地交付文件");
+    return;
+  }
+  m_localMapped = true;
+
+  const char *data = reinterpret_cast<const char *>(mapped);
+  if (size >= kFormatSniffBytes && memcmp(data, "ISO-10303-21", 12) == 0) {
+    // STEP 需经临时文件读取，保留完整正文
+    m_bodyMode = BodyMode::Buffer;
+    m_body = QByteArray(data, static_cast<int>(size));
+    releaseLocalBody();
+    return;
+  }
+
+  m_bodyMode = BodyMode::Local;
+  JhbDecoder *self = this;
+  // 映射区在 onParserFinished / abort 中 join 线程之后才释放
+  m_parser = std::thread([self, data, size]() {
+    MemoryStreamBuf buffer(data, static_cast<size_t>(size));
+    std::istream in(&buffer);
+    TopoDS_Shape shape;
+    BRep_Builder builder;
+    try {
+      BRepTools::Read(shape, in, builder);
+    } catch (const Standard_Failure &) {
+      shape.Nullify();
+    }
+    QMetaObject::invokeMethod(
+        self, [self, shape]() { self->onParserFinished(shape); },
+        Qt::QueuedConnection);
+  });
+}
+
+void JhbDecoder::releaseLocalBody() {
+  if (!m_localFile)
+    return;
+  m_localFile->close(); // 同时解除映射
+  if (m_localMapped)
+    m_localFile->remove();
+  m_localFile.reset();
+  m_localMapped = false;
+}
+
+void JhbDecoder::finish() {
+  if (m_state == State::Done)
+    return; // 接收过程中已失败（如解压出错），错误已发出
+  m_finished = true;
+
+  if (m_state != State::Body) {
+    fail("JHB 数据不完整");
+    return;
+  }
+
+  if (m_bodyMode == BodyMode::Unknown) {
+    // 正文不足判定长度：空正文直接结束，否则按已有前缀判定
+    if (m_pending.isEmpty()) {
+      emitDecoded();
+      return;
+    }
+    selectBodyMode();
+  }
+
+  if (m_bodyMode == BodyMode::Stream || m_bodyMode == BodyMode::Local) {
+    if (m_stream)
+      m_stream->close();
+    if (m_parserDone)
+      emitDecoded();
+    return;
+  }
+  emitDecoded();
+}
+
+void JhbDecoder::abort() {
+  if (m_stream)
+    m_stream->abort();
+  if (m_parser.joinable())
+    m_parser.join();
+  releaseLocalBody();
+  m_state = State::Done;
+}
+
+void JhbDecoder::fail(const QString &error) {
+  abort();
+  emit failed(error);
+}
+
+void JhbDecoder::onParserFinished(const TopoDS_Shape &shape) {
+  if (m_parser.joinable())
+    m_parser.join();
+  releaseLocalBody();
+  if (m_state == State::Done)
+    return;
+
+  m_parserDone = true;
+  m_shape = shape;
+  if (m_shape.IsNull()) {
+    qWarning() << "BRepTools::Read failed to parse streamed JHB body";
+  }
+  if (m_finished)
+    emitDecoded();
+}
+
+void JhbDecoder::emitDecoded() {
+  m_state = State::Done;
+  emit decoded(m_shape, m_body);
+}
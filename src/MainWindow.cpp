@@ -6,11 +6,14 @@
 #include "SARibbonPanel.h"
 #include <BRepBuilderAPI_Transform.hxx>
 
+#include "../include/JhbDecoder.h"
+#include "../include/NetworkReplay.h"
 #include "../include/PythonSyntaxHighlighter.h"
 #include "../include/ShxTextGenerator.h"
 #include <QApplication>
 #include <QCheckBox>
 #include <QComboBox>
+#include <QCryptographicHash>
 #include <QDataStream>
 #include <QDateTime>
 #include <QDebug>
@@ -18,6 +21,7 @@
 #include <QDockWidget>
 #include <QFileDialog>
 #include <QIcon>
+#include <QJsonArray>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMenuBar>
@@ -25,11 +29,13 @@
 #include <QNetworkAccessManager>
 #include <QNetworkProxy>
 #include <QNetworkReply>
+#include <QPointer>
 #include <QPushButton>
 #include <QScrollArea>
 #include <QSpinBox>
 #include <QStatusBar>
 #include <QTextEdit>
+#include <QTimer>
 #include <QUuid>
 #include <QVBoxLayout>
 
@@ -58,6 +64,16 @@ MainWindow::MainWindow(QWidget *parent)
   m_coordLabel->setMinimumWidth(280);
   sBar->addPermanentWidget(m_coordLabel);
 
+  // 服务端各阶段耗时（批量生成时显示）
+  m_serviceLabel = new QLabel("正在连接服务...", this);
+  sBar->addPermanentWidget(m_serviceLabel);
+  m_metricsLabel = new QLabel(this);
+  m_metricsLabel->setVisible(false);
+  sBar->addPermanentWidget(m_metricsLabel);
+  m_metricsTimer = new QTimer(this);
+  m_metricsTimer->setInterval(500);
+  connect(m_metricsTimer, &QTimer::timeout, this, &MainWindow::pollMetrics);
+
   // 连接鼠标位置信号
   connect(m_occtWidget, &OCCTWidget::mousePositionChanged, this,
           &MainWindow::onMousePositionChanged);
@@ -194,6 +210,7 @@ void MainWindow::createRibbon() {
         QString("全部并发生成中: 共 %1 个桥墩已全部发送至微服务...")
             .arg(m_bridgePierCount));
     m_batchTimer.start(); // 开始计时
+    startMetricsPolling();
 
     // 一次性发出所有任务，服务端异步并发处理
     while (!m_batchQueue.isEmpty()) {
@@ -211,20 +228,12 @@ void MainWindow::createRibbon() {
     m_bridgePierCount = 300;
     m_bridgePierSpacing = 31600.0; // 31.6m spacing (31.5m girder + 10cm gap)
     m_completedTasks = 0;
-    m_assemblyParts.clear();
-    m_batchQueue.clear();
-    for (int i = 0; i < 9; ++i) { // 桩、承台、墩身、托盘、垫石x2、支座x2、箱梁
-      m_batchQueue.enqueue(i);
-    }
 
     statusBar()->showMessage(QString("准备基础构件中: 正在调用后台微服务..."));
     m_batchTimer.start();
+    startMetricsPolling();
 
-    // 发送并发拼装任务请求
-    int initialTasks = qMin(9, m_batchQueue.size());
-    for (int i = 0; i < initialTasks; ++i) {
-      dispatchTask();
-    }
+    startPierAssembly();
   });
   panelBridge->addLargeAction(fastAssemAction);
 
@@ -346,23 +355,12 @@ void MainWindow::onDrawFullBridgePier() {
   m_bridgePierSpacing = 0.0;
   m_completedTasks = 0;
   m_batchParts.clear();
-  m_assemblyParts.clear();
-
-  // 定义待请求的脚本列表
-  // 索引 0-7 分别对应：桩、承台、墩身、托盘、垫石1、垫石2、支座1、支座2
-  m_batchQueue.clear();
-  for (int i = 0; i < 9; ++i) {
-    m_batchQueue.enqueue(i);
-  }
 
   statusBar()->showMessage("正在通过微服务分项构建全要素桥墩...");
   m_batchTimer.start();
+  startMetricsPolling();
 
-  // 手动触发初始任务请求
-  int initialCount = qMin(5, m_batchQueue.size());
-  for (int i = 0; i < initialCount; ++i) {
-    dispatchTask();
-  }
+  startPierAssembly();
 }
 
 void MainWindow::onAnnotateBridgePierFooting() {
@@ -786,9 +784,253 @@ void MainWindow::setupCadQueryUi() {
 }
 
 void MainWindow::initializeCqNetwork() {
-  m_networkManager =
-      QSharedPointer<QNetworkAccessManager>(new QNetworkAccessManager());
+  // QTOCCT_RECORD_DIR: 录制服务端应答；QTOCCT_REPLAY_DIR: 脱离服务端回放录制内容
+  // (QTOCCT_REPLAY_LATENCY 固定首字节延迟毫秒，QTOCCT_REPLAY_CHUNK 分块字节数)
+  const QString recordDir = qEnvironmentVariable("QTOCCT_RECORD_DIR");
+  const QString replayDir = qEnvironmentVariable("QTOCCT_REPLAY_DIR");
+  if (!replayDir.isEmpty()) {
+    auto *manager = new ReplayNetworkAccessManager(replayDir);
+    bool ok = false;
+    const int latency = qEnvironmentVariableIntValue("QTOCCT_REPLAY_LATENCY", &ok);
+    if (ok)
+      manager->setLatency(latency);
+    const int chunk = qEnvironmentVariableIntValue("QTOCCT_REPLAY_CHUNK", &ok);
+    if (ok && chunk > 0)
+      manager->setChunkSize(chunk);
+    m_networkManager = QSharedPointer<QNetworkAccessManager>(manager);
+  } else if (!recordDir.isEmpty()) {
+    m_networkManager = QSharedPointer<QNetworkAccessManager>(
+        new RecordingNetworkAccessManager(recordDir));
+  } else {
+    m_networkManager =
+        QSharedPointer<QNetworkAccessManager>(new QNetworkAccessManager());
+  }
   m_networkManager->setProxy(QNetworkProxy::NoProxy);
+  // 同机交付的结果文件解析后即删除，录制/回放时改用 HTTP 正文
+  m_handoffDir = qEnvironmentVariable("QTOCCT_HANDOFF_DIR",
+                                     "/dev/shm/occt-handoff");
+  // 交付目录由服务启动时创建，待服务就绪后再检查（见 pollServiceReady）
+  m_localTransport = qEnvironmentVariable("QTOCCT_LOCAL_TRANSPORT") != "0" &&
+                     recordDir.isEmpty() && replayDir.isEmpty();
+
+  m_endpoints.clear();
+  const QString endpointList = qEnvironmentVariable(
+      "QTOCCT_SERVICE_ENDPOINTS", "http://127.0.0.1:8000");
+  for (const QString &entry : endpointList.split(',', Qt::SkipEmptyParts)) {
+    ServiceEndpoint endpoint;
+    endpoint.base = QUrl(entry.trimmed());
+    if (endpoint.base.isValid())
+      m_endpoints.append(endpoint);
+  }
+  if (m_endpoints.isEmpty()) {
+    ServiceEndpoint endpoint;
+    endpoint.base = QUrl("http://127.0.0.1:8000");
+    m_endpoints.append(endpoint);
+  }
+
+  for (int i = 0; i < m_endpoints.size(); ++i) {
+    if (replayDir.isEmpty()) {
+      // 启动时预先建立 keep-alive 连接，首次建模请求不再承担 TCP 握手
+      const QUrl &base = m_endpoints[i].base;
+      m_networkManager->connectToHost(base.host(), base.port(80));
+    }
+    pollServiceReady(i);
+  }
+  fetchSchemas();
+}
+
+QUrl MainWindow::serviceUrl(int endpoint, const QString &path) const {
+  return m_endpoints[endpoint].base.resolved(QUrl(path));
+}
+
+int MainWindow::pickEndpoint() const {
+  // 最少未完成请求；全部实例都处于出错暂停期时忽略暂停
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  int best = -1;
+  for (int pass = 0; pass < 2 && best < 0; ++pass) {
+    for (int i = 0; i < m_endpoints.size(); ++i) {
+      if (pass == 0 && m_endpoints[i].downUntil > now)
+        continue;
+      if (best < 0 || m_endpoints[i].outstanding < m_endpoints[best].outstanding)
+        best = i;
+    }
+  }
+  return best;
+}
+
+void MainWindow::pollServiceReady(int endpoint) {
+  QNetworkRequest request(serviceUrl(endpoint, "/api/v1/ready"));
+  QNetworkReply *reply = m_networkManager->get(request);
+  connect(reply, &QNetworkReply::finished, this, [this, reply, endpoint]() {
+    reply->deleteLater();
+    const int httpStatus =
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QJsonObject state = QJsonDocument::fromJson(reply->readAll()).object();
+    ServiceEndpoint &target = m_endpoints[endpoint];
+
+    // 404: 服务端没有就绪检查（旧版本或回放未录制），能响应即视为就绪
+    // 503: 工作进程池预热中（导入 cadquery），预热完成前的请求会排队
+    target.reachable = httpStatus != 0;
+    target.ready = httpStatus == 200 || httpStatus == 404;
+    target.workers = state.value("workers").toInt();
+    target.minWorkers = state.value("minSize").toInt();
+    target.downUntil =
+        target.reachable ? 0 : QDateTime::currentMSecsSinceEpoch() + 2000;
+    updateServiceLabel();
+
+    if (target.ready) {
+      if (m_localTransport && !QDir(m_handoffDir).exists()) {
+        // 服务未创建交付目录（远程部署或目录配置不一致），改用 HTTP 正文
+        qWarning() << "交付目录不存在，不启用同机交付:" << m_handoffDir;
+        m_localTransport = false;
+      }
+      if (m_schemaCache.isEmpty()) {
+        fetchSchemas(); // 启动时服务尚未监听则在此补取
+      }
+      return;
+    }
+    QTimer::singleShot(target.reachable ? 500 : 2000, this,
+                       [this, endpoint]() { pollServiceReady(endpoint); });
+  });
+}
+
+void MainWindow::updateServiceLabel() {
+  int ready = 0;
+  int reachable = 0;
+  int workers = 0;
+  int minWorkers = 0;
+  for (const ServiceEndpoint &endpoint : m_endpoints) {
+    if (!endpoint.reachable)
+      continue;
+    ++reachable;
+    workers += endpoint.workers;
+    minWorkers += endpoint.minWorkers;
+    if (endpoint.ready)
+      ++ready;
+  }
+  const QString instances =
+      m_endpoints.size() > 1
+          ? QString(" [%1/%2 实例]").arg(ready).arg(m_endpoints.size())
+          : QString();
+
+  if (ready == m_endpoints.size()) {
+    m_serviceLabel->setText(
+        (workers > 0 ? QString("服务就绪 (%1 个进程)").arg(workers)
+                     : QString("服务就绪")) +
+        instances);
+    m_serviceLabel->setStyleSheet("color: #2e7d32;");
+  } else if (ready > 0) {
+    m_serviceLabel->setText("服务部分就绪" + instances);
+    m_serviceLabel->setStyleSheet("color: #ef6c00;");
+  } else if (reachable > 0) {
+    m_serviceLabel->setText(
+        QString("服务预热中 %1/%2").arg(workers).arg(minWorkers) + instances);
+    m_serviceLabel->setStyleSheet("color: #ef6c00;");
+  } else {
+    m_serviceLabel->setText("服务未连接" + instances);
+    m_serviceLabel->setStyleSheet("color: #c62828;");
+  }
+}
+
+void MainWindow::fetchSchemas() {
+  if (m_schemaFetchPending)
+    return;
+  m_schemaFetchPending = true;
+
+  QNetworkRequest request(serviceUrl(0, "/api/v1/schemas?format=ordered"));
+  QNetworkReply *reply = m_networkManager->get(request);
+  connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    m_schemaFetchPending = false;
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError) {
+      qWarning() << "获取 Schema 失败:" << reply->errorString();
+      return;
+    }
+
+    const QJsonObject models = QJsonDocument::fromJson(reply->readAll()).object();
+    for (auto it = models.begin(); it != models.end(); ++it) {
+      const QJsonObject entry = it.value().toObject();
+      const QString id = entry.value("id").toString();
+      if (!id.isEmpty()) {
+        m_schemaCache.insert(id, entry.value("schema").toObject().toVariantMap());
+      }
+    }
+  });
+}
+
+void MainWindow::startMetricsPolling() {
+  m_metricsBaseline = QJsonObject();
+  m_metricsLabel->setText("服务指标: 等待数据...");
+  m_metricsLabel->setVisible(true);
+  pollMetrics();
+  m_metricsTimer->start();
+}
+
+void MainWindow::pollMetrics() {
+  // 批量结束后再取一次，显示最终的分项耗时
+  if (!m_isBatchProcessing && !m_isAssembling) {
+    m_metricsTimer->stop();
+  }
+  if (m_metricsPollPending)
+    return;
+  m_metricsPollPending = true;
+
+  // 指标取自首个实例
+  QNetworkRequest request(serviceUrl(0, "/api/v1/metrics"));
+  QNetworkReply *reply = m_networkManager->get(request);
+  connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    m_metricsPollPending = false;
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError)
+      return;
+
+    const QJsonObject snapshot =
+        QJsonDocument::fromJson(reply->readAll()).object();
+    if (m_metricsBaseline.isEmpty()) {
+      m_metricsBaseline = snapshot;
+    }
+
+    // 区间平均：两次快照的 sum/count 之差，区分排队与计算耗时
+    const QJsonObject stages = snapshot.value("stages").toObject();
+    const QJsonObject baseStages =
+        m_metricsBaseline.value("stages").toObject();
+    auto meanMs = [&](const QString &stage) {
+      const QJsonObject cur = stages.value(stage).toObject();
+      const QJsonObject base = baseStages.value(stage).toObject();
+      const double count =
+          cur.value("count").toDouble() - base.value("count").toDouble();
+      const double sum =
+          cur.value("sumMs").toDouble() - base.value("sumMs").toDouble();
+      return count > 0 ? sum / count : 0.0;
+    };
+
+    const QJsonObject pool = snapshot.value("pool").toObject();
+    m_metricsLabel->setText(
+        QString("排队 %1 | 执行 %2 | 导出 %3 | 管道 %4 | 封装 %5 ms | "
+                "进程 %6/%7 忙 队列 %8")
+            .arg(meanMs("queue_wait"), 0, 'f', 0)
+            .arg(meanMs("exec"), 0, 'f', 0)
+            .arg(meanMs("export"), 0, 'f', 0)
+            .arg(meanMs("ipc"), 0, 'f', 0)
+            .arg(meanMs("package"), 0, 'f', 0)
+            .arg(pool.value("busy").toInt())
+            .arg(pool.value("size").toInt())
+            .arg(pool.value("queueDepth").toInt()));
+  });
+}
+
+void MainWindow::resolveSchema(QVariantMap &metadata) {
+  if (metadata.contains("schema") || !metadata.contains("schemaId"))
+    return;
+
+  const QString id = metadata.value("schemaId").toString();
+  auto it = m_schemaCache.constFind(id);
+  if (it != m_schemaCache.constEnd()) {
+    metadata.insert("schema", it.value());
+  } else {
+    // 服务端 schema 已更新，刷新缓存供后续构件使用
+    fetchSchemas();
+  }
 }
 
 void MainWindow::onRunCqScript() {
@@ -805,28 +1047,129 @@ void MainWindow::onRunCqScript() {
 void MainWindow::sendScriptToMicroservice(const QString &code,
                                           const QJsonObject &args,
                                           int assemblyIndex,
-                                          const QString &modelType) {
+                                          const QString &modelType,
+                                          int attempts) {
+  const int endpoint = pickEndpoint();
+  ServiceEndpoint &target = m_endpoints[endpoint];
+  const QByteArray codeHash =
+      QCryptographicHash::hash(code.toUtf8(), QCryptographicHash::Sha256)
+          .toHex();
+  // 服务端已缓存的脚本只发送哈希，未命中 (409) 时再补传全文。
+  // 哈希在带全文的请求成功 (200) 后才记录：批量并行请求在此之前都带全文，
+  // 不会先于上传到达服务端而得到 409
+  const bool sendHashOnly = target.uploadedScriptHashes.contains(codeHash);
+
   QJsonObject req;
-  req["code"] = code;
+  req["code_hash"] = QString::fromLatin1(codeHash);
+  if (!sendHashOnly) {
+    req["code"] = code;
+  }
   req["args"] = args;
   req["model_type"] = modelType;
   req["format"] = "brep";
+  if (!m_schemaCache.isEmpty()) {
+    req["header_format"] = "cbor";
+  }
+  if (m_localTransport) {
+    // 服务端仅对回环地址的客户端启用，远程部署自动退回 HTTP 正文
+    req["transport"] = "local";
+  }
+  // 声明可解压的正文编码，由服务端协商是否压缩 B-rep 正文
+  const QStringList encodings = JhbDecoder::supportedEncodings();
+  if (!encodings.isEmpty()) {
+    req["accept_encoding"] = QJsonArray::fromStringList(encodings);
+  }
 
   QJsonDocument doc(req);
   QByteArray postData = doc.toJson();
   qDebug() << "Sending request to microservice:" << postData;
 
-  QNetworkRequest request(QUrl("http://127.0.0.1:8000/api/v1/model/generate"));
+  QNetworkRequest request(serviceUrl(endpoint, "/api/v1/model/generate"));
   request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
   QNetworkReply *reply = m_networkManager->post(request, postData);
+  target.outstanding++;
+  reply->setProperty("endpoint", endpoint);
+  reply->setProperty("attempts", attempts);
 
   // Track assemblyIndex alongside the reply so callback knows how to process it
   reply->setProperty("assemblyIndex", assemblyIndex);
+  // 保留原始请求，脚本缓存未命中时据此补传全文重发
+  reply->setProperty("scriptCode", code);
+  reply->setProperty("scriptArgs", args);
+  reply->setProperty("modelType", modelType);
+  reply->setProperty("codeHash", codeHash);
+  reply->setProperty("sentHashOnly", sendHashOnly);
+
+  // JHB 增量解码：头部到达即可更新属性面板，B-rep 正文边接收边解析
+  JhbDecoder *decoder = new JhbDecoder(this);
+  decoder->setHandoffDirectory(m_handoffDir);
+  // 结果与错误在创建时即连接，接收过程中的错误（如解压失败）立即处理
+  connect(decoder, &JhbDecoder::failed, this,
+          [this, decoder, assemblyIndex, code, args,
+           modelType](const QString &error) {
+            qWarning() << "JHB 解析失败:" << error;
+            if (decoder->metadata().contains("localBody")) {
+              // 交付文件不可访问（如服务运行在容器中），改用 HTTP 正文重发
+              m_localTransport = false;
+              decoder->deleteLater();
+              sendScriptToMicroservice(code, args, assemblyIndex, modelType);
+              return;
+            }
+            QVariantMap metadata = decoder->metadata();
+            resolveSchema(metadata);
+            // 按空形状计入，拼装/批量计数照常推进
+            onCqPartDecoded(assemblyIndex, TopoDS_Shape(), metadata);
+            decoder->deleteLater();
+          });
+  connect(decoder, &JhbDecoder::decoded, this,
+          [this, decoder, assemblyIndex](const TopoDS_Shape &streamed,
+                                         const QByteArray &body) {
+            TopoDS_Shape shape = streamed;
+            if (shape.IsNull() && !body.isEmpty()) {
+              // 非 B-rep 正文 (如 STEP) 走完整缓冲解析
+              shape = m_occtWidget->readBrepFromMemory(body);
+            }
+            QVariantMap metadata = decoder->metadata();
+            resolveSchema(metadata);
+            onCqPartDecoded(assemblyIndex, shape, metadata);
+            decoder->deleteLater();
+          });
+  connect(reply, &QNetworkReply::readyRead, decoder, [reply, decoder]() {
+    // 错误响应 (4xx/5xx) 的正文留给 finished 处理
+    const int httpStatus =
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->error() == QNetworkReply::NoError && httpStatus == 200) {
+      decoder->feed(reply->readAll());
+    }
+  });
+  if (assemblyIndex == -1) {
+    connect(decoder, &JhbDecoder::headerReady, this,
+            [this](const QVariantMap &header) {
+              QVariantMap metadata = header;
+              resolveSchema(metadata);
+              onObjectSelected(metadata);
+              statusBar()->showMessage(
+                  QString("正在接收模型: %1")
+                      .arg(metadata.value("name").toString()));
+            });
+  } else if (m_isAssembling) {
+    // out 参数随头部到达，依赖它的构件无需等待本构件的 B-rep 正文
+    connect(decoder, &JhbDecoder::headerReady, this,
+            [this, assemblyIndex](const QVariantMap &header) {
+              if (!m_isAssembling)
+                return;
+              m_jobGraph.resolveOutputs(assemblyIndex,
+                                        header.value("args").toMap());
+              dispatchReadyJobs();
+            });
+  }
 
-  connect(reply, &QNetworkReply::finished, [this, reply]() {
+  // 解码器可能已在接收过程中失败并释放
+  QPointer<JhbDecoder> decoderGuard(decoder);
+  connect(reply, &QNetworkReply::finished, [this, reply, decoderGuard]() {
     int assemblyIdx = reply->property("assemblyIndex").toInt();
-    this->onCqNetworkReply(reply, assemblyIdx);
+    this->onCqNetworkReply(reply, assemblyIdx, decoderGuard.data());
   });
 
   if (assemblyIndex == -1) {
@@ -839,58 +1182,144 @@ void MainWindow::dispatchTask(int) {
     return;
   int index = m_batchQueue.dequeue();
 
-  QString modelName;
   QJsonObject args;
   args["pierHeight"] = m_pierHeightSpinBox->value();
 
-  if (m_isAssembling) {
-    // Map index to script name for full bridge pier assembly
-    switch (index) {
-    case 0:
-      modelName = "Pile";
-      break;
-    case 1:
-      modelName = "Chengtai";
-      break;
-    case 2:
-      modelName = "Dunshen";
-      break;
-    case 3:
-      modelName = "TuopanDingmao";
-      break;
-    case 4: // bed_stone 1
-    case 5: // bed_stone 2
-      modelName = "bed_stone";
-      break;
-    case 6: // bearing 1
-    case 7: // bearing 2
-      modelName = "bearing";
-      break;
-    case 8: // girder
-      modelName = "girder";
-      break;
-    default:
-      qWarning() << "Unknown assembly index:" << index;
-      return;
-    }
+  // 独立批量生成全桥 (通过 C++ 循环位移并各自使用 BridgePier2 脚本)
+  const QString modelName = "BridgePier2"; // 实际使用的脚本模板名
+  QString code = readScript(modelName);
 
-    QString code = readScript(modelName);
-    sendScriptToMicroservice(code, args, index, modelName);
-  } else {
-    // 独立批量生成全桥 (通过 C++ 循环位移并各自使用 BridgePier2 脚本)
-    modelName = "BridgePier2"; // 实际使用的脚本模板名
-    QString code = readScript(modelName);
+  // 注意：在这里发送 args，其中 yOffset 是由 C++ 计算出来的毫米值
+  args["yOffset"] = index * m_bridgePierSpacing;
+
+  sendScriptToMicroservice(code, args, index, modelName);
+}
+
+// 全要素桥墩的构件编号，与 buildFullBridgeFromParts 的部件顺序一致
+enum PierPart {
+  PilePart = 0,
+  ChengtaiPart,
+  DunshenPart,
+  TuopanPart,
+  StonePart1,
+  StonePart2,
+  BearingPart1,
+  BearingPart2,
+  GirderPart
+};
+
+void MainWindow::startPierAssembly() {
+  QJsonObject args;
+  args["pierHeight"] = m_pierHeightSpinBox->value();
 
-    // 注意：在这里发送 args，其中 yOffset 是由 C++ 计算出来的毫米值
-    args["yOffset"] = index * m_bridgePierSpacing;
+  m_jobGraph.clear();
+  m_jobGraph.addJob("Pile", args);
+  m_jobGraph.addJob("Chengtai", args);
+  m_jobGraph.addJob("Dunshen", args);
+  m_jobGraph.addJob("TuopanDingmao", args);
+  m_jobGraph.addJob("bed_stone", args);
+  m_jobGraph.addJob("bed_stone", args);
+  m_jobGraph.addJob("bearing", args);
+  m_jobGraph.addJob("bearing", args);
+  m_jobGraph.addJob("girder", args);
+  // 桩基、承台与墩身取同一 pierHeight，互不依赖，全部立即发出；
+  // 仅当墩身另传与 pierHeight 不同的 height 时才需绑定到墩身的 out 参数
 
-    sendScriptToMicroservice(code, args, index, modelName);
+  m_assemblyParts.clear();
+  for (int i = 0; i < m_jobGraph.size(); ++i) {
+    m_assemblyParts.append(
+        {TopoDS_Shape(), Graphic3d_NOM_PLASTIC, QVariantMap()});
   }
+  dispatchReadyJobs();
 }
 
-void MainWindow::onCqNetworkReply(QNetworkReply *reply, int assemblyIndex) {
+void MainWindow::dispatchReadyJobs() {
+  for (int job : m_jobGraph.takeReady()) {
+    const QString modelName = m_jobGraph.modelType(job);
+    sendScriptToMicroservice(readScript(modelName), m_jobGraph.inputArgs(job),
+                             job, modelName);
+  }
+}
+
+void MainWindow::finishPierAssembly() {
+  // 安放位置由上游构件的 out 参数逐级推算：顶帽顶面 -> 垫石顶面 -> 支座顶面
+  const double capTop = m_jobGraph.output(TuopanPart, "top", 3000.0);
+  const double seatX = m_jobGraph.output(TuopanPart, "seatX", 1650.0);
+  const double stoneTop = capTop +
+                          m_jobGraph.output(StonePart1, "z_min", -50.0) +
+                          m_jobGraph.output(StonePart1, "height", 400.0);
+  const double bearingTop =
+      stoneTop + m_jobGraph.output(BearingPart1, "height", 250.0);
+
+  m_assemblyParts[StonePart1].offset = gp_Vec(-seatX, 0, capTop);
+  m_assemblyParts[StonePart2].offset = gp_Vec(seatX, 0, capTop);
+  m_assemblyParts[BearingPart1].offset = gp_Vec(-seatX, 0, stoneTop);
+  m_assemblyParts[BearingPart2].offset = gp_Vec(seatX, 0, stoneTop);
+  m_assemblyParts[GirderPart].offset = gp_Vec(0, 0, bearingTop);
+
+  m_occtWidget->buildFullBridgeFromParts(m_assemblyParts, m_bridgePierCount,
+                                         m_bridgePierSpacing);
+  const int failed = m_jobGraph.failedCount();
+  statusBar()->showMessage(
+      failed == 0
+          ? QString("全桥拼装完成. 耗时: %1 ms").arg(m_batchTimer.elapsed())
+          : QString("全桥拼装完成, %1 个构件生成失败").arg(failed),
+      5000);
+  m_isAssembling = false;
+  m_occtWidget->fitAll();
+}
+
+void MainWindow::onCqNetworkReply(QNetworkReply *reply, int assemblyIndex,
+                                  JhbDecoder *decoder) {
   QApplication::restoreOverrideCursor();
+  const int endpoint = reply->property("endpoint").toInt();
+  ServiceEndpoint &source = m_endpoints[endpoint];
+  source.outstanding--;
+  // 解码器在接收过程中已失败（或已被释放）时结果已由 failed 计入
+  const bool decodeReported = !decoder || decoder->isDone();
   if (reply->error() != QNetworkReply::NoError) {
+    if (decoder)
+      decoder->deleteLater();
+    if (decodeReported) {
+      reply->deleteLater();
+      return;
+    }
+    const int httpStatus =
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (httpStatus == 409 && reply->property("sentHashOnly").toBool()) {
+      // 服务端脚本缓存未命中（重启或淘汰），补传脚本全文后重发
+      source.uploadedScriptHashes.remove(
+          reply->property("codeHash").toByteArray());
+      sendScriptToMicroservice(reply->property("scriptCode").toString(),
+                               reply->property("scriptArgs").toJsonObject(),
+                               assemblyIndex,
+                               reply->property("modelType").toString());
+      reply->deleteLater();
+      return;
+    }
+
+    // 连接失败或服务端内部错误：暂停向该实例分配，转发到其他实例
+    // (脚本错误为 400，换实例也无济于事)
+    const int attempts = reply->property("attempts").toInt() + 1;
+    const bool endpointFailed =
+        (httpStatus == 0 || httpStatus >= 500) &&
+        reply->error() != QNetworkReply::OperationCanceledError;
+    if (endpointFailed) {
+      source.downUntil = QDateTime::currentMSecsSinceEpoch() + 5000;
+      source.uploadedScriptHashes.clear(); // 实例可能已重启
+      if (attempts < m_endpoints.size()) {
+        qWarning() << "服务实例出错，转发到其他实例:"
+                   << source.base.toString() << reply->errorString();
+        sendScriptToMicroservice(reply->property("scriptCode").toString(),
+                                 reply->property("scriptArgs").toJsonObject(),
+                                 assemblyIndex,
+                                 reply->property("modelType").toString(),
+                                 attempts);
+        reply->deleteLater();
+        return;
+      }
+    }
+
     QByteArray errData = reply->readAll();
     QString errMsg = reply->errorString();
     if (!errData.isEmpty()) {
@@ -898,66 +1327,71 @@ void MainWindow::onCqNetworkReply(QNetworkReply *reply, int assemblyIndex) {
     }
     QMessageBox::critical(this, "Network Error", errMsg);
 
-    if (m_isAssembling) {
-      m_completedTasks++;
-      if (m_completedTasks == 8) {
-        statusBar()->showMessage("脚本拼装中断", 5000);
-        m_isAssembling = false;
-      } else {
-        dispatchTask();
-      }
+    if (m_isAssembling || m_isRegenerating) {
+      // 按失败构件计入，下游沿用默认参数继续拼装
+      onCqPartDecoded(assemblyIndex, TopoDS_Shape(), QVariantMap());
     }
     reply->deleteLater();
     return;
   }
 
-  QByteArray data = reply->readAll();
-  reply->deleteLater();
-
-  // --- JHB 协议解析 ---
-  if (data.size() < 4) {
-    qWarning() << "JHB 数据过短";
-    return;
-  }
-
-  uint32_t jsonLen = 0;
-  memcpy(&jsonLen, data.constData(), 4); // 小端序
+  // 服务端已收到并缓存该脚本，此后只发送哈希
+  source.uploadedScriptHashes.insert(reply->property("codeHash").toByteArray());
 
-  if (data.size() < (int)(4 + jsonLen)) {
-    qWarning() << "JHB 元数据长度异常";
+  reply->deleteLater();
+  if (decodeReported)
     return;
-  }
-
-  QByteArray jsonData = data.mid(4, jsonLen);
-  QByteArray brepData = data.mid(4 + jsonLen);
-
-  QJsonDocument doc = QJsonDocument::fromJson(jsonData);
-  QVariantMap metadata = doc.object().toVariantMap();
+  // 读取 readyRead 之后剩余的数据并结束 JHB 解码
+  decoder->feed(reply->readAll());
+  decoder->finish();
+}
 
-  if (m_isAssembling) {
-    TopoDS_Shape shape = m_occtWidget->readBrepFromMemory(brepData);
-    while (m_assemblyParts.size() <= assemblyIndex) {
-      m_assemblyParts.append(
-          {TopoDS_Shape(), Graphic3d_NOM_PLASTIC, QVariantMap()});
+void MainWindow::onCqPartDecoded(int assemblyIndex, const TopoDS_Shape &shape,
+                                 const QVariantMap &metadata) {
+  if (m_isRegenerating) {
+    // 同一参数组合的结果分发给组内所有实例，原位替换
+    if (!shape.IsNull() && assemblyIndex < m_regenGroups.size()) {
+      for (const RegenTarget &target : m_regenGroups[assemblyIndex].targets) {
+        QVariantMap instanceMetadata = metadata;
+        gp_Trsf shift;
+        if (target.yOffset != 0.0) {
+          shift.SetTranslation(gp_Vec(0, target.yOffset, 0));
+          QVariantMap args = instanceMetadata.value("args").toMap();
+          args["yOffset"] = target.yOffset;
+          instanceMetadata["args"] = args;
+        }
+        m_occtWidget->replaceShape(target.object,
+                                   shape.Moved(TopLoc_Location(shift)),
+                                   instanceMetadata);
+      }
+      m_occtWidget->update();
+    }
+    if (--m_pendingRegenGroups == 0) {
+      int instances = 0;
+      for (const RegenGroup &group : m_regenGroups)
+        instances += group.targets.size();
+      m_isRegenerating = false;
+      m_regenGroups.clear();
+      statusBar()->showMessage(QString("已重新生成 %1 个构件. 耗时: %2 ms")
+                                   .arg(instances)
+                                   .arg(m_batchTimer.elapsed()),
+                               5000);
     }
+  } else if (m_isAssembling) {
     Graphic3d_NameOfMaterial mat = Graphic3d_NOM_STONE;
-    if (assemblyIndex == 6 || assemblyIndex == 7)
+    if (assemblyIndex == BearingPart1 || assemblyIndex == BearingPart2)
       mat = Graphic3d_NOM_STEEL;
 
     m_assemblyParts[assemblyIndex] = {shape, mat, metadata};
-    m_completedTasks++;
+    m_jobGraph.resolveOutputs(assemblyIndex, metadata.value("args").toMap());
+    m_jobGraph.complete(assemblyIndex, !shape.IsNull());
 
-    if (m_completedTasks == 9) {
-      m_occtWidget->buildFullBridgeFromParts(m_assemblyParts, m_bridgePierCount,
-                                             m_bridgePierSpacing);
-      statusBar()->showMessage("全桥拼装完成", 5000);
-      m_isAssembling = false;
-      m_occtWidget->fitAll();
+    if (m_jobGraph.isFinished()) {
+      finishPierAssembly();
     } else {
-      dispatchTask();
+      dispatchReadyJobs();
     }
   } else if (m_isBatchProcessing) {
-    TopoDS_Shape shape = m_occtWidget->readBrepFromMemory(brepData);
     if (!shape.IsNull()) {
       m_batchParts.append({shape, m_currentMaterial, metadata});
     }
@@ -976,7 +1410,6 @@ void MainWindow::onCqNetworkReply(QNetworkReply *reply, int assemblyIndex) {
     }
   } else {
     m_occtWidget->clearAll();
-    TopoDS_Shape shape = m_occtWidget->readBrepFromMemory(brepData);
     if (!shape.IsNull()) {
       m_occtWidget->displayShape(shape, m_currentMaterial, true, metadata);
     }
@@ -1057,6 +1490,7 @@ void MainWindow::onObjectSelected(const QVariantMap &metadata) {
                          ? currentArgs.value(key).toDouble()
                          : fieldInfo.value("default", 0.0).toDouble();
         dsb->setValue(val);
+        dsb->setProperty("initialValue", dsb->value()); // 多选时只下发改动项
         if (readOnly) {
           dsb->setReadOnly(true);
           dsb->setStyleSheet("background-color: #f0f0f0; color: #666;");
@@ -1068,6 +1502,7 @@ void MainWindow::onObjectSelected(const QVariantMap &metadata) {
                           : fieldInfo.value("default", "").toString();
         QLineEdit *edit = new QLineEdit(val);
         edit->setObjectName(key); // 设置控件名方便后续查询
+        edit->setProperty("initialValue", val);
         if (readOnly) {
           edit->setReadOnly(true);
           edit->setStyleSheet("background-color: #f0f0f0; color: #666;");
@@ -1075,6 +1510,34 @@ void MainWindow::onObjectSelected(const QVariantMap &metadata) {
         m_propertyLayout->addWidget(edit);
       }
     }
+
+    // 全局参数 pierHeight 不在 schema 中，构件由它生成时同样允许编辑
+    bool hasPierHeightField = false;
+    for (const QVariant &fieldVar : fields) {
+      if (fieldVar.toMap().value("key").toString() == "pierHeight")
+        hasPierHeightField = true;
+    }
+    if (currentArgs.contains("pierHeight") && !hasPierHeightField) {
+      QLabel *label = new QLabel("墩高 (mm)");
+      label->setStyleSheet("margin-top: 8px; font-weight: bold;");
+      m_propertyLayout->addWidget(label);
+      QDoubleSpinBox *dsb = new QDoubleSpinBox();
+      dsb->setObjectName("pierHeight");
+      dsb->setRange(-1000000, 1000000);
+      dsb->setSingleStep(100.0);
+      dsb->setValue(currentArgs.value("pierHeight").toDouble());
+      dsb->setProperty("initialValue", dsb->value());
+      m_propertyLayout->addWidget(dsb);
+    }
+  }
+
+  const int selectedCount = m_occtWidget->selectedObjects().size();
+  if (selectedCount > 1) {
+    QLabel *hint = new QLabel(
+        QString("已选中 %1 个构件：修改的参数将应用到所有同类构件").arg(selectedCount));
+    hint->setWordWrap(true);
+    hint->setStyleSheet("color: #0078d4; margin-top: 8px;");
+    m_propertyLayout->addWidget(hint);
   }
 
   m_propertyLayout->addSpacing(20);
@@ -1086,6 +1549,7 @@ void MainWindow::onObjectSelected(const QVariantMap &metadata) {
   // 绑定点击事件：收集参数并重新触发建模
   connect(updateBtn, &QPushButton::clicked, [this, modelType]() {
     QJsonObject newArgs;
+    QJsonObject edits; // 与面板初始值不同的参数
     // 遍历布局找到所有的输入控件
     for (int i = 0; i < m_propertyLayout->count(); ++i) {
       QWidget *w = m_propertyLayout->itemAt(i)->widget();
@@ -1098,18 +1562,29 @@ void MainWindow::onObjectSelected(const QVariantMap &metadata) {
       if (QDoubleSpinBox *dsb = qobject_cast<QDoubleSpinBox *>(w)) {
         if (!dsb->isReadOnly()) {
           newArgs[key] = dsb->value();
+          if (dsb->value() != dsb->property("initialValue").toDouble())
+            edits[key] = dsb->value();
         }
       } else if (QLineEdit *le = qobject_cast<QLineEdit *>(w)) {
         if (!le->isReadOnly()) {
           newArgs[key] = le->text();
+          if (le->text() != le->property("initialValue").toString())
+            edits[key] = le->text();
         }
       }
     }
 
     qDebug() << "Updating model with args:" << newArgs;
 
+    if (!m_occtWidget->selectedObjects().isEmpty()) {
+      // 视图中有选中的构件：原位重新生成（多选时按参数组合去重）
+      regenerateSelection(modelType, edits);
+      return;
+    }
+
     // 注入全局参数，确保脚本（如墩身、承台）能正常运行
-    newArgs["pierHeight"] = m_pierHeightSpinBox->value();
+    if (!newArgs.contains("pierHeight"))
+      newArgs["pierHeight"] = m_pierHeightSpinBox->value();
 
     QString code = readScript(modelType);
     if (!code.isEmpty()) {
@@ -1125,6 +1600,81 @@ void MainWindow::onObjectSelected(const QVariantMap &metadata) {
   m_propertyLayout->addStretch();
 }
 
+void MainWindow::regenerateSelection(const QString &modelType,
+                                     const QJsonObject &edits) {
+  if (m_isRegenerating) {
+    statusBar()->showMessage("上一次重新生成尚未完成", 3000);
+    return;
+  }
+  // 应答按全局状态分发：拼装/批量进行中时其应答会被当作重新生成的分组
+  if (m_isAssembling || m_isBatchProcessing) {
+    statusBar()->showMessage("拼装或批量生成尚未完成，请稍后再重新生成", 3000);
+    return;
+  }
+
+  m_regenGroups.clear();
+  QHash<QByteArray, int> groupOfArgs;
+  int instances = 0;
+  for (const Handle(AIS_InteractiveObject) &object :
+       m_occtWidget->selectedObjects()) {
+    const QVariantMap metadata = m_occtWidget->objectMetadata(object);
+    if (metadata.value("modelType").toString() != modelType)
+      continue; // 只处理与属性面板同类的构件
+
+    // 实例的输入参数：schema 中非 out 的字段，加上全局参数 pierHeight/yOffset
+    const QVariantMap currentArgs = metadata.value("args").toMap();
+    const QVariantList fields =
+        metadata.value("schema").toMap().value("fields").toList();
+    QJsonObject args;
+    for (const QVariant &fieldVar : fields) {
+      const QVariantMap fieldInfo = fieldVar.toMap();
+      const QString key = fieldInfo.value("key").toString();
+      const QString access = fieldInfo.value("access", "inout").toString();
+      if (access != "out" && access != "output" && currentArgs.contains(key))
+        args[key] = QJsonValue::fromVariant(currentArgs.value(key));
+    }
+    for (const QString &key : {QString("pierHeight"), QString("yOffset")}) {
+      if (currentArgs.contains(key))
+        args[key] = QJsonValue::fromVariant(currentArgs.value(key));
+    }
+    for (auto it = edits.begin(); it != edits.end(); ++it) {
+      args[it.key()] = it.value();
+    }
+    if (!args.contains("pierHeight"))
+      args["pierHeight"] = m_pierHeightSpinBox->value();
+
+    // 安放参数不参与分组：按 yOffset=0 生成一次，结果平移到各实例
+    const double yOffset = args.take("yOffset").toDouble();
+    const QByteArray key = QJsonDocument(args).toJson(QJsonDocument::Compact);
+    auto found = groupOfArgs.constFind(key);
+    int group = found != groupOfArgs.constEnd() ? found.value() : -1;
+    if (group < 0) {
+      group = m_regenGroups.size();
+      groupOfArgs.insert(key, group);
+      m_regenGroups.append({args, {}});
+    }
+    m_regenGroups[group].targets.append({object, yOffset});
+    ++instances;
+  }
+
+  if (m_regenGroups.isEmpty()) {
+    statusBar()->showMessage(
+        QString("选中对象中没有 %1 构件，未重新生成").arg(modelType), 3000);
+    return;
+  }
+
+  const QString code = readScript(modelType);
+  m_isRegenerating = true;
+  m_pendingRegenGroups = m_regenGroups.size();
+  m_batchTimer.start();
+  for (int i = 0; i < m_regenGroups.size(); ++i) {
+    sendScriptToMicroservice(code, m_regenGroups[i].args, i, modelType);
+  }
+  statusBar()->showMessage(QString("正在重新生成 %1 个构件 (%2 组不同参数)")
+                               .arg(instances)
+                               .arg(m_regenGroups.size()));
+}
+
 QString MainWindow::readScript(const QString &modelName) {
   QString path = QDir::currentPath() + "/cq_script/" + modelName + ".py";
   QFile file(path);
@@ -0,0 +1,296 @@
+#include "../include/NetworkReplay.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QTimer>
+
+#include <cstring>
+#include <functional>
+#include <memory>
+
+namespace {
+
+// 请求键：方法 + 路径 + 影响应答内容的请求字段
+QString requestKey(QNetworkAccessManager::Operation op,
+                   const QNetworkRequest &request, const QByteArray &body) {
+  const QByteArray path =
+      request.url().toEncoded(QUrl::RemoveScheme | QUrl::RemoveAuthority);
+  QByteArray material = QByteArray::number(int(op)) + ' ' + path + '\n';
+  QString label = request.url().fileName();
+
+  QJsonObject req = QJsonDocument::fromJson(body).object();
+  if (!req.isEmpty()) {
+    // 只发哈希与发送全文、HTTP 与同机交付得到的是同一份模型
+    req.remove("code");
+    req.remove("code_hash");
+    req.remove("transport");
+    material += QJsonDocument(req).toJson(QJsonDocument::Compact);
+    const QString modelType = req.value("model_type").toString();
+    if (!modelType.isEmpty())
+      label = modelType;
+  } else {
+    material += body;
+  }
+
+  const QByteArray hash =
+      QCryptographicHash::hash(material, QCryptographicHash::Sha1).toHex();
+  return label + "-" + QString::fromLatin1(hash.left(16));
+}
+
+// 从内存缓冲区向调用方提供数据的应答，录制代理与回放共用
+class BufferedReply : public QNetworkReply {
+public:
+  BufferedReply(QNetworkAccessManager::Operation op,
+                const QNetworkRequest &request, QObject *parent)
+      : QNetworkReply(parent) {
+    setOperation(op);
+    setRequest(request);
+    setUrl(request.url());
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+  }
+
+  std::function<void()> onAbort; // 录制时转发给真实应答
+
+  void abort() override {
+    if (isFinished())
+      return;
+    if (onAbort) {
+      onAbort();
+      return;
+    }
+    m_playback.clear();
+    finishWithError(OperationCanceledError, "Operation canceled");
+  }
+
+  bool isSequential() const override { return true; }
+
+  qint64 bytesAvailable() const override {
+    return m_data.size() - m_offset + QNetworkReply::bytesAvailable();
+  }
+
+  void copyMetaData(const QNetworkReply *source) {
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute,
+                 source->attribute(QNetworkRequest::HttpStatusCodeAttribute));
+    for (const auto &header : source->rawHeaderPairs()) {
+      setRawHeader(header.first, header.second);
+    }
+  }
+
+  void setMetaData(int status, const QJsonObject &headers) {
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, status);
+    for (auto it = headers.begin(); it != headers.end(); ++it) {
+      setRawHeader(it.key().toLatin1(), it.value().toString().toLatin1());
+    }
+  }
+
+  void appendData(const QByteArray &chunk) {
+    if (chunk.isEmpty())
+      return;
+    m_data.append(chunk);
+    emit readyRead();
+  }
+
+  void finishReply() {
+    setFinished(true);
+    emit finished();
+  }
+
+  void finishWithError(NetworkError code, const QString &message) {
+    setError(code, message);
+    emit errorOccurred(code);
+    finishReply();
+  }
+
+  // 延迟 firstByteMs 后按 chunkSize 分块交付 body，块间隔 intervalMs
+  void playBack(const QByteArray &body, int firstByteMs, int intervalMs,
+                int chunkSize) {
+    m_playback = body;
+    m_playbackOffset = 0;
+    m_intervalMs = intervalMs;
+    m_chunkSize = chunkSize;
+    QTimer::singleShot(firstByteMs, this, [this]() {
+      emit metaDataChanged();
+      deliverNext();
+    });
+  }
+
+protected:
+  qint64 readData(char *data, qint64 maxSize) override {
+    const qint64 count = qMin<qint64>(maxSize, m_data.size() - m_offset);
+    if (count <= 0)
+      return isFinished() ? -1 : 0;
+    std::memcpy(data, m_data.constData() + m_offset, size_t(count));
+    m_offset += count;
+    if (m_offset == m_data.size()) {
+      m_data.clear();
+      m_offset = 0;
+    }
+    return count;
+  }
+
+private:
+  void deliverNext() {
+    if (isFinished())
+      return;
+    if (m_playbackOffset >= m_playback.size()) {
+      m_playback.clear();
+      finishReply();
+      return;
+    }
+    appendData(m_playback.mid(m_playbackOffset, m_chunkSize));
+    m_playbackOffset += m_chunkSize;
+    QTimer::singleShot(m_intervalMs, this, [this]() { deliverNext(); });
+  }
+
+  QByteArray m_data; // 已到达、尚未被读取的数据
+  qint64 m_offset = 0;
+
+  QByteArray m_playback;
+  qsizetype m_playbackOffset = 0;
+  int m_intervalMs = 0;
+  int m_chunkSize = 0;
+};
+
+struct Capture {
+  QString key;
+  QElapsedTimer timer;
+  qint64 firstByteMs = -1;
+  QByteArray body;
+};
+
+void saveRecording(const QString &directory, const Capture &capture,
+                   const QNetworkReply *reply) {
+  QDir dir(directory);
+  dir.mkpath(".");
+
+  QJsonObject headers;
+  for (const auto &header : reply->rawHeaderPairs()) {
+    headers[QString::fromLatin1(header.first)] =
+        QString::fromLatin1(header.second);
+  }
+
+  QJsonObject meta;
+  meta["url"] = reply->url().toString();
+  meta["status"] =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  meta["headers"] = headers;
+  meta["firstByteMs"] = qMax<qint64>(capture.firstByteMs, 0);
+  meta["totalMs"] = capture.timer.elapsed();
+  meta["bytes"] = capture.body.size();
+
+  // 先写正文，元数据文件存在即表示录制完整
+  QFile bodyFile(dir.filePath(capture.key + ".body"));
+  QFile metaFile(dir.filePath(capture.key + ".json"));
+  if (!bodyFile.open(QIODevice::WriteOnly) ||
+      bodyFile.write(capture.body) != capture.body.size() ||
+      !metaFile.open(QIODevice::WriteOnly)) {
+    qWarning() << "写入录制失败:" << capture.key;
+    return;
+  }
+  bodyFile.close();
+  metaFile.write(QJsonDocument(meta).toJson());
+}
+
+} // namespace
+
+RecordingNetworkAccessManager::RecordingNetworkAccessManager(
+    const QString &directory, QObject *parent)
+    : QNetworkAccessManager(parent), m_directory(directory) {}
+
+QNetworkReply *RecordingNetworkAccessManager::createRequest(
+    Operation op, const QNetworkRequest &request, QIODevice *outgoingData) {
+  const QByteArray requestBody =
+      outgoingData ? outgoingData->peek(outgoingData->size()) : QByteArray();
+
+  QNetworkReply *upstream =
+      QNetworkAccessManager::createRequest(op, request, outgoingData);
+  auto *reply = new BufferedReply(op, request, this);
+  upstream->setParent(reply);
+  reply->onAbort = [upstream]() { upstream->abort(); };
+
+  auto capture = std::make_shared<Capture>();
+  capture->key = requestKey(op, request, requestBody);
+  capture->timer.start();
+
+  connect(upstream, &QNetworkReply::metaDataChanged, reply, [reply, upstream]() {
+    reply->copyMetaData(upstream);
+    emit reply->metaDataChanged();
+  });
+  connect(upstream, &QNetworkReply::readyRead, reply,
+          [reply, upstream, capture]() {
+            const QByteArray chunk = upstream->readAll();
+            if (capture->firstByteMs < 0)
+              capture->firstByteMs = capture->timer.elapsed();
+            capture->body += chunk;
+            reply->copyMetaData(upstream);
+            reply->appendData(chunk);
+          });
+  connect(upstream, &QNetworkReply::finished, reply,
+          [this, reply, upstream, capture]() {
+            const QByteArray rest = upstream->readAll();
+            capture->body += rest;
+            reply->copyMetaData(upstream);
+            reply->appendData(rest);
+
+            const int status =
+                upstream->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+                    .toInt();
+            if (upstream->error() == QNetworkReply::NoError && status == 200) {
+              saveRecording(m_directory, *capture, upstream);
+              reply->finishReply();
+            } else {
+              reply->finishWithError(upstream->error(),
+                                     upstream->errorString());
+            }
+          });
+  return reply;
+}
+
+ReplayNetworkAccessManager::ReplayNetworkAccessManager(const QString &directory,
+                                                       QObject *parent)
+    : QNetworkAccessManager(parent), m_directory(directory) {}
+
+QNetworkReply *ReplayNetworkAccessManager::createRequest(
+    Operation op, const QNetworkRequest &request, QIODevice *outgoingData) {
+  const QByteArray requestBody =
+      outgoingData ? outgoingData->readAll() : QByteArray();
+  const QString key = requestKey(op, request, requestBody);
+  auto *reply = new BufferedReply(op, request, this);
+
+  QDir dir(m_directory);
+  QFile metaFile(dir.filePath(key + ".json"));
+  QFile bodyFile(dir.filePath(key + ".body"));
+  if (!metaFile.open(QIODevice::ReadOnly) ||
+      !bodyFile.open(QIODevice::ReadOnly)) {
+    QTimer::singleShot(0, reply, [reply, key]() {
+      reply->setMetaData(404, QJsonObject());
+      reply->finishWithError(QNetworkReply::ContentNotFoundError,
+                             QString("回放目录中没有该请求的录制: %1").arg(key));
+    });
+    return reply;
+  }
+
+  const QJsonObject meta = QJsonDocument::fromJson(metaFile.readAll()).object();
+  const QByteArray body = bodyFile.readAll();
+  reply->setMetaData(meta.value("status").toInt(200),
+                     meta.value("headers").toObject());
+
+  int firstByteMs = m_latencyMs;
+  int intervalMs = 0;
+  if (m_latencyMs < 0) {
+    // 按录制耗时回放：首字节延迟不变，其余耗时均摊到各块
+    firstByteMs = meta.value("firstByteMs").toInt();
+    const int chunks =
+        qMax(1, int((body.size() + m_chunkSize - 1) / m_chunkSize));
+    intervalMs =
+        qMax(0, meta.value("totalMs").toInt() - firstByteMs) / chunks;
+  }
+  reply->playBack(body, firstByteMs, intervalMs, m_chunkSize);
+  return reply;
+}
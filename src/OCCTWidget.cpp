@@ -1,6 +1,7 @@
 #include "../include/OCCTWidget.h"
 #include "../include/AspectWindow.h"
 #include "../include/Line.h"
+#include "../include/MemoryStreamBuf.h"
 
 #include <Aspect_DisplayConnection.hxx>
 #include <BRepBuilderAPI_MakeEdge.hxx>
@@ -38,6 +39,8 @@
 #include <gp_Pln.hxx>
 #include <gp_Trsf.hxx>
 
+#include <istream>
+
 OCCTWidget::OCCTWidget(QWidget *parent)
     : QWidget(parent), m_viewer(nullptr), m_view(nullptr), m_context(nullptr),
       m_graphicDriver(nullptr), m_aspectWindow(nullptr),
@@ -320,9 +323,13 @@ void OCCTWidget::mousePressEvent(QMouseEvent *event) {
                       static_cast<int>(event->pos().y() * pixelRatio), m_view,
                       true);
 
-    m_context->Select(true);
+    if (event->modifiers() & Qt::ShiftModifier) {
+      m_context->ShiftSelect(true); // Shift+单击: 加入/移出选择集
+    } else {
+      m_context->Select(true);
+    }
 
-    // 发出对象选中信号
+    // 发出对象选中信号（多选时为第一个选中对象）
     m_context->InitSelected();
     if (m_context->MoreSelected()) {
       Handle(AIS_InteractiveObject) selObj = m_context->SelectedInteractive();
@@ -1674,8 +1681,7 @@ TopoDS_Shape OCCTWidget::readBrepFromMemory(const QByteArray &data) {
     return TopoDS_Shape();
 
   // 格式检测
-  std::string dataStr(data.constData(), data.length());
-  bool isStep = (dataStr.find("ISO-10303-21") != std::string::npos);
+  bool isStep = data.contains("ISO-10303-21");
 
   if (isStep) {
     QTemporaryFile tempFile;
@@ -1704,8 +1710,10 @@ TopoDS_Shape OCCTWidget::readBrepFromMemory(const QByteArray &data) {
     // 尝试作为 BREP 解析
     TopoDS_Shape shape;
     BRep_Builder builder;
-    std::stringstream ss(dataStr);
-    BRepTools::Read(shape, ss, builder);
+    // 直接在 QByteArray 上解析，避免复制到 std::string / stringstream
+    MemoryStreamBuf buffer(data.constData(), static_cast<size_t>(data.size()));
+    std::istream in(&buffer);
+    BRepTools::Read(shape, in, builder);
     if (shape.IsNull()) {
       qWarning()
           << "BRepTools::Read failed to parse shape from memory! Data size:"
@@ -1797,22 +1805,11 @@ void OCCTWidget::buildFullBridgeFromParts(
         continue;
 
       gp_Trsf pierTrsf;
-      gp_Vec offset(0, yOff, 0);
-
-      // 特殊处理垫石和支座的 X/Z 位移
-      if (j == 4)
-        offset += gp_Vec(-1650.0, 0, 3000.0); // Stone 1
-      if (j == 5)
-        offset += gp_Vec(1650.0, 0, 3000.0); // Stone 2
-      if (j == 6)
-        offset += gp_Vec(-1650.0, 0, 3400.0); // Bearing 1
-      if (j == 7)
-        offset += gp_Vec(1650.0, 0, 3400.0); // Bearing 2
-
-      pierTrsf.SetTranslation(offset);
+      // 垫石和支座的 X/Z 位移已由拼装流程写入 offset
+      pierTrsf.SetTranslation(gp_Vec(0, yOff, 0) + parts[j].offset);
 
-      BRepBuilderAPI_Transform xform(parts[j].shape, pierTrsf, true);
-      TopoDS_Shape shape = xform.Shape();
+      // 各墩共享同一几何，实例位置记录在 Location 中（重新生成时据此原位替换）
+      TopoDS_Shape shape = parts[j].shape.Moved(TopLoc_Location(pierTrsf));
 
       Quantity_Color color = Quantity_NOC_GRAY75;
       if (j >= 4 && j <= 5)
@@ -1830,14 +1827,14 @@ void OCCTWidget::buildFullBridgeFromParts(
         rot.SetRotation(gp_Ax1(gp_Pnt(0, 0, 0), gp_Dir(0, 0, 1)), M_PI / 2.0);
 
         gp_Trsf trans;
-        // 梁放置在支座上方 Z=3650.0
+        // 梁放置在支座顶面 (offset.Z)
         // 墩间距 31.6m, 梁长 31.5m, 缝隙 100mm, 每端 50mm
-        trans.SetTranslation(gp_Vec(0, yOff + 50.0, 3650.0));
+        trans.SetTranslation(gp_Vec(0, yOff + 50.0, 0) + parts[8].offset);
 
         gp_Trsf girderTrsf = trans * rot;
-        BRepBuilderAPI_Transform xform(parts[8].shape, girderTrsf, true);
-        displayShape(xform.Shape(), parts[8].material, Quantity_NOC_GRAY75,
-                     false, parts[8].metadata);
+        displayShape(parts[8].shape.Moved(TopLoc_Location(girderTrsf)),
+                     parts[8].material, Quantity_NOC_GRAY75, false,
+                     parts[8].metadata);
       }
     }
   }
@@ -1889,3 +1886,34 @@ void OCCTWidget::buildFullBridgeFromBatch(
 
   fitAll();
 }
+
+QList<Handle(AIS_InteractiveObject)> OCCTWidget::selectedObjects() const {
+  QList<Handle(AIS_InteractiveObject)> objects;
+  if (m_context.IsNull())
+    return objects;
+  for (m_context->InitSelected(); m_context->MoreSelected();
+       m_context->NextSelected()) {
+    objects.append(m_context->SelectedInteractive());
+  }
+  return objects;
+}
+
+QVariantMap
+OCCTWidget::objectMetadata(const Handle(AIS_InteractiveObject) &object) const {
+  return m_objectMetadata.value(object);
+}
+
+void OCCTWidget::replaceShape(const Handle(AIS_InteractiveObject) &object,
+                              const TopoDS_Shape &shape,
+                              const QVariantMap &metadata) {
+  Handle(AIS_Shape) aisShape = Handle(AIS_Shape)::DownCast(object);
+  if (aisShape.IsNull() || shape.IsNull() || m_context.IsNull())
+    return;
+
+  // 新形状按旧实例的位置摆放（全桥拼装的各墩实例共享几何、仅位置不同）
+  aisShape->SetShape(shape.Moved(aisShape->Shape().Location()));
+  m_context->Redisplay(aisShape, false);
+  if (!metadata.isEmpty()) {
+    m_objectMetadata[aisShape] = metadata;
+  }
+}
@@ -1,16 +1,12 @@
 #include "../include/ShxTextGenerator.h"
 #include "../libs/shxparser/include/ShxParser.h"
-#include <BRepBndLib.hxx>
 #include <BRepBuilderAPI_GTransform.hxx>
 #include <BRepBuilderAPI_MakeEdge.hxx>
 #include <BRepBuilderAPI_MakeVertex.hxx>
 #include <BRepBuilderAPI_MakeWire.hxx>
 #include <BRepBuilderAPI_Transform.hxx>
 #include <BRep_Builder.hxx>
-#include <Bnd_Box.hxx>
 #include <GC_MakeArcOfCircle.hxx>
-#include <QByteArray>
-#include <QString>
 #include <TopoDS.hxx>
 #include <TopoDS_Compound.hxx>
 #include <gp_Ax1.hxx>
@@ -25,122 +21,13 @@ ShxTextGenerator::ShxTextGenerator()
     : m_font(new shx::ShxFont()), m_bigFont(new shx::ShxFont()) {}
 ShxTextGenerator::~ShxTextGenerator() = default;
 
+// 字体旁的 .shxc 缓存与源文件一致时直接映射使用，否则重新编译并写回缓存
 bool ShxTextGenerator::loadFont(const std::string &fontPath) {
-  return m_font->load(fontPath);
+  return m_font->loadCached(fontPath, shx::defaultCachePath(fontPath));
 }
 
 bool ShxTextGenerator::loadBigFont(const std::string &fontPath) {
-  return m_bigFont->load(fontPath);
-}
-
-// Helper for recursive Bounding Box scan
-static void scanGlyphBBox(const shx::ShxFont *font, const shx::Glyph *glyph,
-                          double offsetX, double offsetY, double &minX,
-                          double &maxX, double &minY, double &maxY,
-                          bool &hasGeo, int depth = 0,
-                          gp_Pnt startPen = gp_Pnt(0, 0, 0)) {
-  if (!glyph || depth > 10)
-    return;
-
-  // Local pen tracking relative to offset
-  // Should we pass Current Pen from caller?
-  // For SubShape, yes? No, SubShape defines its own valid context usually?
-  // In SHX, SubShape is just a macro.
-  // But usually SubShapes are self-contained or start at their local 0,0?
-  // No, SubShape command documentation says it uses current pen?
-  // Actually, cmd.subShapeId is just an ID.
-  // The parser stores 'x,y' in DrawCommand for SubShape insertion point.
-  // So we can treat it as a fresh start at that point?
-
-  // In our parser logic, 'drawGlyphRecursive' passes 'origin' (Start Point) and
-  // 'currentPen'. We should probably init 'currentPen' to (offsetX, offsetY)
-  // which is the Insertion Point.
-
-  gp_Pnt currentPen(offsetX, offsetY, 0.0);
-
-  // If this is a recursive call for a SubShape that CONTINUES the path, we
-  // might need the actual pen? But 'scanGlyphBBox' is called with specific
-  // Absolute 'offsetX, offsetY'. In recursion (Step 1082 Line 61):
-  // scanGlyphBBox(..., absX, absY, ...) which is the Insertion Point. And
-  // 'currentPen' should start there.
-
-  for (const auto &cmd : glyph->commands) {
-    // cmd.endPoint is relative to Glyph Origin (0,0 of the glyph definition).
-    // So Absolute EndPoint = offsetX + cmd.endPoint.x
-
-    double absX = offsetX + cmd.endPoint.x;
-    double absY = offsetY + cmd.endPoint.y;
-    gp_Pnt endP(absX, absY, 0.0);
-
-    if (cmd.type == shx::CommandType::MoveTo) {
-      currentPen = endP;
-    } else if (cmd.type == shx::CommandType::LineTo) {
-      // Check Start (currentPen) and End (endP)
-      if (currentPen.X() < minX)
-        minX = currentPen.X();
-      if (currentPen.X() > maxX)
-        maxX = currentPen.X();
-      if (currentPen.Y() < minY)
-        minY = currentPen.Y();
-      if (currentPen.Y() > maxY)
-        maxY = currentPen.Y();
-
-      if (endP.X() < minX)
-        minX = endP.X();
-      if (endP.X() > maxX)
-        maxX = endP.X();
-      if (endP.Y() < minY)
-        minY = endP.Y();
-      if (endP.Y() > maxY)
-        maxY = endP.Y();
-
-      hasGeo = true;
-      currentPen = endP;
-    } else if (cmd.type == shx::CommandType::ArcTo) {
-      // Calculate Arc Bounds
-      double ctrlAbsX = offsetX + cmd.controlPoint.x;
-      double ctrlAbsY = offsetX + cmd.controlPoint.y; // WRONG: offsetY
-      ctrlAbsY = offsetY + cmd.controlPoint.y;
-
-      gp_Pnt ctrlP(ctrlAbsX, ctrlAbsY, 0.0);
-
-      try {
-        GC_MakeArcOfCircle mkArc(currentPen, ctrlP, endP);
-        if (mkArc.IsDone()) {
-          TopoDS_Edge edge = BRepBuilderAPI_MakeEdge(mkArc.Value());
-          Bnd_Box box;
-          BRepBndLib::Add(edge, box);
-
-          double xmin, ymin, zmin, xmax, ymax, zmax;
-          box.Get(xmin, ymin, zmin, xmax, ymax, zmax);
-
-          if (xmin < minX)
-            minX = xmin;
-          if (xmax > maxX)
-            maxX = xmax;
-          if (ymin < minY)
-            minY = ymin;
-          if (ymax > maxY)
-            maxY = ymax;
-          hasGeo = true;
-        }
-      } catch (...) {
-      }
-
-      currentPen = endP;
-    } else if (cmd.type == shx::CommandType::SubShape) {
-      const shx::Glyph *sub = font->getGlyphByShape(cmd.subShapeId);
-      if (sub) {
-        // Use local pen for subshape to isolate state
-        gp_Pnt subPen = endP;
-        scanGlyphBBox(font, sub, absX, absY, minX, maxX, minY, maxY, hasGeo,
-                      depth + 1, subPen);
-      }
-      // Strict restore for current context
-      currentPen = endP;
-      continue;
-    }
-  }
+  return m_bigFont->loadCached(fontPath, shx::defaultCachePath(fontPath));
 }
 
 // Helper for recursive Drawing
@@ -267,10 +154,7 @@ ShxTextGenerator::generateText(const std::string &text, const gp_Pnt &position,
     if (baseH == 0) {
       const shx::Glyph *g = m_font->getGlyph('A');
       if (g) {
-        double minX = 1e9, maxX = -1e9, minY = 1e9, maxY = -1e9;
-        bool hasGeo = false;
-        scanGlyphBBox(&(*m_font), g, 0, 0, minX, maxX, minY, maxY, hasGeo);
-        baseH = (hasGeo) ? (maxY - minY) : 20.0;
+        baseH = g->inkBounds.valid ? g->inkBounds.height() : 20.0;
         if (baseH <= 0)
           baseH = 20.0;
       } else {
@@ -290,39 +174,38 @@ ShxTextGenerator::generateText(const std::string &text, const gp_Pnt &position,
       scaleBigFont = height / baseH;
   }
 
-  QByteArray gbData = QString::fromStdString(text).toLocal8Bit();
+  // UTF-8 直接映射为字体编码（BigFont 查内置 GBK 表），不依赖系统区域设置
   gp_Pnt cursorPos(0, 0, 0);
 
-  for (int i = 0; i < gbData.size(); ++i) {
-    uint8_t b1 = static_cast<uint8_t>(gbData[i]);
-    uint32_t code = 0;
-    bool isBig = false;
-
-    if (b1 < 0x80) {
-      code = b1;
-    } else {
-      if (i + 1 < gbData.size()) {
-        uint8_t b2 = static_cast<uint8_t>(gbData[i + 1]);
-        code = (b1 << 8) | b2;
-        isBig = true;
-        i++;
-      } else {
-        continue;
-      }
-    }
+  for (size_t pos = 0; pos < text.size();) {
+    uint32_t codePoint = shx::nextCodePoint(text, pos);
+    uint32_t code = codePoint;
 
     const shx::ShxFont *activeFont = &(*m_font);
     const shx::Glyph *glyph = nullptr;
     double activeScale = scaleFont;
 
-    if (isBig && m_bigFont->getGlyphCount() > 0) {
-      glyph = m_bigFont->getGlyph(code);
-      if (glyph) {
-        activeFont = &(*m_bigFont);
-        activeScale = scaleBigFont;
-      }
-    } else {
+    if (codePoint < 0x80) {
       glyph = m_font->getGlyph(code);
+    } else {
+      if (m_bigFont->getGlyphCount() > 0) {
+        code = m_bigFont->mapCodePoint(codePoint);
+        glyph = code ? m_bigFont->getGlyph(code) : nullptr;
+        if (glyph) {
+          activeFont = &(*m_bigFont);
+          activeScale = scaleBigFont;
+        }
+      }
+      // 无 BigFont 或 BigFont 缺字时回退到主字体：先按 Unicode（如 unifont），
+      // 再按 GBK 双字节编码（主字体本身带汉字时）
+      if (!glyph) {
+        code = codePoint;
+        glyph = m_font->getGlyph(code);
+      }
+      if (!glyph) {
+        code = shx::unicodeToGbk(codePoint);
+        glyph = code ? m_font->getGlyph(code) : nullptr;
+      }
     }
 
     if (!glyph) {
@@ -341,14 +224,12 @@ ShxTextGenerator::generateText(const std::string &text, const gp_Pnt &position,
       continue;
     }
 
-    // 1. Scan BBox (Recursive)
-    double minX = 1e9, maxX = -1e9;
-    double minY = 1e9, maxY = -1e9;
-    bool hasGeo = false;
-
-    scanGlyphBBox(activeFont, glyph, 0, 0, minX, maxX, minY, maxY, hasGeo);
+    // 1. Ink BBox (computed by the parser when the glyph was compiled)
+    const shx::Bounds &ink = glyph->inkBounds;
+    double minX = ink.minX, maxX = ink.maxX;
+    double minY = ink.minY, maxY = ink.maxY;
 
-    if (!hasGeo) {
+    if (!ink.valid) {
       // Fallback for empty glyphs (other than space)
       minX = 0.0;
       // Use a safe fallback width in Font Units (e.g. 20.0 or 0.5*BaseHeight)